@@ -8,42 +8,31 @@
 #include "../bitcoin_app_base/src/crypto.h"
 #include "../bitcoin_app_base/src/common/bip32.h"
 #include "bbn_pub.h"
+#include "bbn_keycache.h"
 #include "bbn_script.h"
 #include "bbn_def.h"
 #include "bbn_data.h"
 #include "bbn_script.h"
 #include "bbn_address.h"
+#include "bbn_taptree.h"
 
 bool bbn_check_staking_address(sign_psbt_state_t *st) {
-    uint8_t tweaked_pubkey[34];
-    uint8_t merkle_root[32];
-
-    if (!g_bbn_data.has_timelock || !g_bbn_data.has_staker_pk || !g_bbn_data.has_cov_key_list ||
-        !g_bbn_data.has_cov_quorum || !g_bbn_data.has_fp_list) {
+    if (!bbn_data_has_fields(BBN_REQUIRED_STAKING | BBN_FIELD(BBN_FIELD_STAKER_PK))) {
         PRINTF("Missing required data for staking address check\n");
         return false;
     }
-    if (g_bbn_data.timelock == 0 || g_bbn_data.timelock > 0x7FFFFFFF) {
+    uint64_t timelock = bbn_data_timelock(g_bbn_data.action_type);
+    if (timelock == 0 || timelock > 0x7FFFFFFF) {
         PRINTF("timelock state is 0 or too large\n");
         return false;
     }
-    // Compute the merkle root
-    compute_bbn_merkle_root(merkle_root);
-    uint8_t parity;
-    // Tweak the staker public key with the merkle root
-    uint8_t NUMS_PUBKEY[] = {0x02, 0x50, 0x92, 0x9b, 0x74, 0xc1, 0xa0, 0x49, 0x54, 0xb7, 0x8b,
-                             0x4b, 0x60, 0x35, 0xe9, 0x7a, 0x5e, 0x07, 0x8a, 0x5a, 0x0f, 0x28,
-                             0xec, 0x96, 0xd5, 0x47, 0xbf, 0xee, 0x9a, 0xce, 0x80, 0x3a, 0xc0};
-    if (crypto_tr_tweak_pubkey(NUMS_PUBKEY + 1, merkle_root, 32, &parity, tweaked_pubkey) != 0) {
-        PRINTF("Failed to tweak public key\n");
+    // the output key and the output script are compared where they are, without copies
+    const uint8_t *tweaked_pubkey = bbn_taptree_output_key_view(BBN_TREE_STAKING);
+    if (tweaked_pubkey == NULL) {
         return false;
     }
 
-    uint8_t out_scriptPubKey[MAX_OUTPUT_SCRIPTPUBKEY_LEN];
-    size_t out_scriptPubKey_len;
-    out_scriptPubKey_len = st->outputs.output_script_lengths[0];
-    memcpy(out_scriptPubKey, st->outputs.output_scripts[0], out_scriptPubKey_len);
-
+    const uint8_t *out_scriptPubKey = st->outputs.output_scripts[0];
     if (memcmp(out_scriptPubKey + 2, tweaked_pubkey, 32)) {
         PRINTF("tweak public key cmp fail\n");
         PRINTF_BUF(tweaked_pubkey, 32);
@@ -54,12 +43,9 @@ bool bbn_check_staking_address(sign_psbt_state_t *st) {
 }
 
 bool bbn_check_slashing_address(sign_psbt_state_t *st) {
-    uint8_t tweaked_pubkey[34];
-    uint8_t merkle_root[32];
-
     PRINTF_BUF(g_bbn_data.staker_pk, 32);
 
-    if (!g_bbn_data.has_timelock || !g_bbn_data.has_staker_pk) {
+    if (!bbn_data_has_fields(BBN_REQUIRED_SLASHING | BBN_FIELD(BBN_FIELD_STAKER_PK))) {
         PRINTF("Missing required data for slashing address check\n");
         return false;
     }
@@ -72,38 +58,23 @@ bool bbn_check_slashing_address(sign_psbt_state_t *st) {
         return false;
     }
 
-    // Compute the merkle root
-    compute_bbn_leafhash_timelock(merkle_root);
-    uint8_t parity;
-    // Tweak the staker public key with the merkle root
-    uint8_t NUMS_PUBKEY[] = {0x02, 0x50, 0x92, 0x9b, 0x74, 0xc1, 0xa0, 0x49, 0x54, 0xb7, 0x8b,
-                             0x4b, 0x60, 0x35, 0xe9, 0x7a, 0x5e, 0x07, 0x8a, 0x5a, 0x0f, 0x28,
-                             0xec, 0x96, 0xd5, 0x47, 0xbf, 0xee, 0x9a, 0xce, 0x80, 0x3a, 0xc0};
-    if (crypto_tr_tweak_pubkey(NUMS_PUBKEY + 1, merkle_root, 32, &parity, tweaked_pubkey) != 0) {
-        PRINTF("Failed to tweak public key\n");
-        PRINTF_BUF(tweaked_pubkey, 32);
+    // the change output goes back to the staker, behind the timelock script only
+    const uint8_t *tweaked_pubkey = bbn_taptree_output_key_view(BBN_TREE_TIMELOCK);
+    if (tweaked_pubkey == NULL) {
         return false;
     }
 
-    uint8_t out_scriptPubKey[MAX_OUTPUT_SCRIPTPUBKEY_LEN];
-    size_t out_scriptPubKey_len;
-    out_scriptPubKey_len = st->outputs.output_script_lengths[1];
-    memcpy(out_scriptPubKey, st->outputs.output_scripts[1], out_scriptPubKey_len);
+    const uint8_t *out_scriptPubKey = st->outputs.output_scripts[1];
 
     // check the slashing output refund address
     if (memcmp(out_scriptPubKey + 2, tweaked_pubkey, 32)) {
         PRINTF("Slashing Tweaked public key:\n");
         PRINTF_BUF(tweaked_pubkey, 32);
-        PRINTF("Slashing out_scriptPubKey_len 1: %d\n", out_scriptPubKey_len);
+        PRINTF("Slashing out_scriptPubKey_len 1: %d\n", st->outputs.output_script_lengths[1]);
         PRINTF_BUF(out_scriptPubKey + 2, 32);
         PRINTF("tweak public key cmp fail\n");
         return false;
     }
-    if (!g_bbn_data.has_burn_address) {
-        PRINTF("Slashing address not found\n");
-        return false;
-    }
-
     if (memcmp(st->outputs.output_scripts[0],
                g_bbn_data.burn_address,
                g_bbn_data.burn_address_len)) {
@@ -124,25 +95,13 @@ bool bbn_check_slashing_address(sign_psbt_state_t *st) {
     return true;
 }
 
-static void compute_bbn_unbond_root(uint8_t *roothash) {
-    uint8_t slashing_leafhash[32];
-    uint8_t timelock_leafhash[32];
-
-    compute_bbn_leafhash_slashing(slashing_leafhash);
-    compute_bbn_leafhash_timelock(timelock_leafhash);
-    crypto_tr_combine_taptree_hashes(slashing_leafhash, timelock_leafhash, roothash);
-}
-
 bool bbn_check_unbond_address(sign_psbt_state_t *st) {
-    uint8_t tweaked_pubkey[34];
-    uint8_t merkle_root[32];
-
-    if (!g_bbn_data.has_timelock || !g_bbn_data.has_staker_pk || !g_bbn_data.has_cov_key_list ||
-        !g_bbn_data.has_cov_quorum || !g_bbn_data.has_unbonding_fee_limit) {
+    if (!bbn_data_has_fields(BBN_REQUIRED_UNBOND | BBN_FIELD(BBN_FIELD_STAKER_PK))) {
         PRINTF("Missing required data for staking address check\n");
         return false;
     }
-    if (g_bbn_data.timelock == 0 || g_bbn_data.timelock > 0x7FFFFFFF) {
+    uint64_t timelock = bbn_data_timelock(g_bbn_data.action_type);
+    if (timelock == 0 || timelock > 0x7FFFFFFF) {
         PRINTF("timelock state is 0 or too large\n");
         return false;
     }
@@ -153,27 +112,17 @@ bool bbn_check_unbond_address(sign_psbt_state_t *st) {
         PRINTF("Unbond Fee not match\n");
         return false;
     }
-    compute_bbn_unbond_root(merkle_root);
-    uint8_t parity;
-
-    uint8_t NUMS_PUBKEY[] = {0x02, 0x50, 0x92, 0x9b, 0x74, 0xc1, 0xa0, 0x49, 0x54, 0xb7, 0x8b,
-                             0x4b, 0x60, 0x35, 0xe9, 0x7a, 0x5e, 0x07, 0x8a, 0x5a, 0x0f, 0x28,
-                             0xec, 0x96, 0xd5, 0x47, 0xbf, 0xee, 0x9a, 0xce, 0x80, 0x3a, 0xc0};
-
-    if (crypto_tr_tweak_pubkey(NUMS_PUBKEY + 1, merkle_root, 32, &parity, tweaked_pubkey) != 0) {
-        PRINTF("Failed to tweak public key\n");
+    const uint8_t *tweaked_pubkey = bbn_taptree_output_key_view(BBN_TREE_UNBONDING);
+    if (tweaked_pubkey == NULL) {
         return false;
     }
 
-    uint8_t out_scriptPubKey[MAX_OUTPUT_SCRIPTPUBKEY_LEN];
-    size_t out_scriptPubKey_len;
-    out_scriptPubKey_len = st->outputs.output_script_lengths[0];
-    memcpy(out_scriptPubKey, st->outputs.output_scripts[0], out_scriptPubKey_len);
+    const uint8_t *out_scriptPubKey = st->outputs.output_scripts[0];
 
     if (memcmp(out_scriptPubKey + 2, tweaked_pubkey, 32)) {
         PRINTF("Tweaked public key:\n");
         PRINTF_BUF(tweaked_pubkey, 32);
-        PRINTF("out_scriptPubKey_len: %d\n", out_scriptPubKey_len);
+        PRINTF("out_scriptPubKey_len: %d\n", st->outputs.output_script_lengths[0]);
         PRINTF_BUF(out_scriptPubKey + 2, 32);
         PRINTF("bbn_check_unbond tweak public key cmp fail\n");
         return false;
@@ -192,42 +141,40 @@ bool bbn_check_message(uint8_t *psbt_txid) {
             // Native SegWit (P2WPKH) - need to derive compressed pubkey
             PRINTF("Using P2WPKH BIP-322 verification\n");
 
-            if (!g_bbn_data.has_message) {
+            if (!BBN_DATA_HAS(BBN_FIELD_MESSAGE)) {
                 PRINTF("Missing message data for P2WPKH BIP-322\n");
                 return false;
             }
 
-            // Get full compressed pubkey (33 bytes) for P2WPKH
-            serialized_extended_pubkey_t xpub;
-            if (0 > get_extended_pubkey_at_path(g_bbn_data.derive_path,
-                                                g_bbn_data.derive_path_len,
-                                                BIP32_PUBKEY_VERSION,
-                                                &xpub)) {
+            // Get full compressed pubkey (33 bytes) for P2WPKH, already derived for the review
+            uint8_t compressed_pubkey[33];
+            if (!bbn_keycache_get_pubkey(g_bbn_data.derive_path,
+                                         g_bbn_data.derive_path_len,
+                                         compressed_pubkey)) {
                 PRINTF("Failed to derive extended pubkey for P2WPKH\n");
                 return false;
             }
 
-            PRINTF("P2WPKH message: ");
-            PRINTF_BUF(g_bbn_data.message, g_bbn_data.message_len);
+            PRINTF("P2WPKH message hash: ");
+            PRINTF_BUF(g_bbn_data.message_hash, 32);
             PRINTF("P2WPKH compressed pubkey: ");
-            PRINTF_BUF(xpub.compressed_pubkey, 33);
+            PRINTF_BUF(compressed_pubkey, 33);
 
-            compute_bip322_txid_by_message_p2wpkh(
-                g_bbn_data.message,
-                g_bbn_data.message_len,
-                xpub.compressed_pubkey,  // 33-byte compressed pubkey
+            compute_bip322_txid_by_message_hash_p2wpkh(
+                g_bbn_data.message_hash,
+                compressed_pubkey,  // 33-byte compressed pubkey
                 txid);
         } else if (purpose == 86) {
-            if (!g_bbn_data.has_message || !g_bbn_data.has_message_key) {
+            if (!bbn_data_has_fields(BBN_FIELD(BBN_FIELD_MESSAGE) |
+                                     BBN_FIELD(BBN_FIELD_MESSAGE_KEY))) {
                 PRINTF("Missing required data for message check\n");
                 return false;
             }
             // Taproot (P2TR) - use x-only pubkey from message_key
             PRINTF("Using Taproot BIP-322 verification\n");
-            compute_bip322_txid_by_message(g_bbn_data.message,
-                                           g_bbn_data.message_len,
-                                           g_bbn_data.message_key,
-                                           txid);
+            compute_bip322_txid_by_message_hash(g_bbn_data.message_hash,
+                                                g_bbn_data.message_key,
+                                                txid);
         } else {
             PRINTF("Unsupported purpose %d for BIP-322\n", purpose);
             return false;
@@ -0,0 +1,86 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include "../bitcoin_app_base/src/crypto.h"
+#include "bbn_def.h"
+#include "bbn_data.h"
+#include "bbn_covenant.h"
+
+// A covenant committee that can be reviewed by name instead of key by key
+typedef struct {
+    uint8_t hash[32];  // bbn_covenant_committee_hash of its keys and quorum
+    char name[40];
+} bbn_covenant_committee_t;
+
+/**
+ * The covenant committees known to testnet builds. The committee is the same for all the
+ * delegations of a network, and only changes with the Babylon parameters version. Mainnet builds
+ * know no committee and review the covenant keys one by one.
+ */
+static const bbn_covenant_committee_t g_known_committees[] = {
+#if BIP32_PUBKEY_VERSION != BIP32_PUBKEY_MAINNET
+    // 9 keys, quorum 6: the committee of the signet delegations in data/
+    {.hash = {0x3c, 0x38, 0x4a, 0x19, 0x63, 0x67, 0xa7, 0xcd, 0xc6, 0x21, 0xab,
+              0xd4, 0x71, 0x8d, 0x99, 0x06, 0x1e, 0xd4, 0x0f, 0x38, 0x3d, 0x3c,
+              0xb9, 0x4e, 0x97, 0xf9, 0xdd, 0xe3, 0xa5, 0xf6, 0xee, 0x19},
+     .name = "Babylon testnet covenant committee v1"},
+#endif
+    {.name = ""},  // end of the table
+};
+
+/**
+ * Hashes a covenant committee independently of the order of its keys: SHA-256 of the keys sorted
+ * in ascending order, then of the quorum. The keys are visited in order without sorting a copy of
+ * them. Returns false if a key is repeated, as such a set is never a known committee.
+ */
+bool bbn_covenant_committee_hash(const uint8_t *keys,
+                                 size_t key_count,
+                                 uint8_t quorum,
+                                 uint8_t out[static 32]) {
+    cx_sha256_t hash_context;
+    const uint8_t *previous = NULL;
+
+    cx_sha256_init(&hash_context);
+    for (size_t n = 0; n < key_count; n++) {
+        // the smallest key after the previous one
+        const uint8_t *next = NULL;
+        for (size_t i = 0; i < key_count; i++) {
+            const uint8_t *key = keys + 32 * i;
+            if ((previous == NULL || memcmp(key, previous, 32) > 0) &&
+                (next == NULL || memcmp(key, next, 32) < 0)) {
+                next = key;
+            }
+        }
+        if (next == NULL) {
+            return false;
+        }
+        crypto_hash_update(&hash_context.header, next, 32);
+        previous = next;
+    }
+    crypto_hash_update_u8(&hash_context.header, quorum);
+    crypto_hash_digest(&hash_context.header, out, 32);
+    return true;
+}
+
+/**
+ * Returns the name of the known committee that the covenant keys used in the scripts and the
+ * quorum are, or NULL if they are not one.
+ */
+const char *bbn_covenant_known_committee(void) {
+    uint8_t hash[32];
+
+    if (!BBN_DATA_HAS(BBN_FIELD_COV_KEY_LIST) || !BBN_DATA_HAS(BBN_FIELD_COV_QUORUM) ||
+        g_bbn_data.cov_key_count > g_bbn_data.cov_key_list.len / 32 ||
+        !bbn_covenant_committee_hash(bbn_data_cov_keys(),
+                                     g_bbn_data.cov_key_count,
+                                     g_bbn_data.cov_quorum,
+                                     hash)) {
+        return NULL;
+    }
+    for (size_t i = 0; g_known_committees[i].name[0] != '\0'; i++) {
+        if (memcmp(g_known_committees[i].hash, hash, 32) == 0) {
+            return g_known_committees[i].name;
+        }
+    }
+    return NULL;
+}
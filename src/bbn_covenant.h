@@ -0,0 +1,16 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#ifndef BBN_COVENANT_H
+#define BBN_COVENANT_H
+
+bool bbn_covenant_committee_hash(const uint8_t *keys,
+                                 size_t key_count,
+                                 uint8_t quorum,
+                                 uint8_t out[static 32]);
+const char *bbn_covenant_known_committee(void);
+
+#endif  // BBN_COVENANT_H
@@ -2,6 +2,124 @@
 #include <stdint.h>
 #include <stddef.h>
 #include "../bitcoin_app_base/src/common/merkle.h"
+#include "bbn_def.h"
 #include "bbn_data.h"
 
-bbn_data_t g_bbn_data;
\ No newline at end of file
+bbn_data_t g_bbn_data;
+
+// The pool of g_bbn_data, in the session cache, and the room it has
+static uint8_t *g_bbn_data_pool;
+static uint16_t g_bbn_data_pool_size;
+
+// Set by the session cache, which holds the pools; NULL for a parameter set without values.
+void bbn_data_set_pool(uint8_t *pool, uint16_t size) {
+    g_bbn_data_pool = pool;
+    g_bbn_data_pool_size = size;
+}
+
+uint8_t *bbn_data_pool(void) {
+    return g_bbn_data_pool;
+}
+
+/**
+ * Reserves len bytes at the end of the pool of g_bbn_data for the given value. Returns where the
+ * value goes, or NULL if the pool is full.
+ */
+uint8_t *bbn_data_pool_alloc(bbn_data_slice_t *slice, uint16_t len) {
+    if (g_bbn_data_pool == NULL || len > g_bbn_data_pool_size - g_bbn_data.pool_len) {
+        return NULL;
+    }
+    slice->offset = g_bbn_data.pool_len;
+    slice->len = len;
+    g_bbn_data.pool_len += len;
+    return g_bbn_data_pool + slice->offset;
+}
+
+bool bbn_data_has_fields(uint32_t mask) {
+    return (g_bbn_data.fields & mask) == mask;
+}
+
+// The fields required by each bbn_action_type_t
+static const uint32_t g_action_required_fields[] = {
+    [BBN_POLICY_SLASHING] = BBN_REQUIRED_SLASHING,
+    [BBN_POLICY_SLASHING_UNBONDING] = BBN_REQUIRED_SLASHING,
+    [BBN_POLICY_STAKE_TRANSFER] = BBN_REQUIRED_STAKING,
+    [BBN_POLICY_UNBOND] = BBN_REQUIRED_UNBOND,
+    [BBN_POLICY_WITHDRAW] = BBN_REQUIRED_WITHDRAW,
+    [BBN_POLICY_BIP322] = BBN_REQUIRED_MESSAGE,
+    [BBN_POLICY_EXPANSION] = BBN_REQUIRED_STAKING,
+};
+
+// Whether g_bbn_data has every field the given bbn_action_type_t needs
+bool bbn_data_has_required(uint32_t action_type) {
+    if (action_type >= sizeof(g_action_required_fields) / sizeof(uint32_t)) {
+        PRINTF("Unknown action type: %d\n", action_type);
+        return false;
+    }
+    uint32_t missing = g_action_required_fields[action_type] & ~g_bbn_data.fields;
+    if (missing != 0) {
+        PRINTF("Missing fields for action %d: 0x%x\n", action_type, missing);
+        return false;
+    }
+    return true;
+}
+
+/**
+ * Whether g_bbn_data is complete: no key count beyond the keys received, and every field its action
+ * needs. Data without an action type passes: the action is then given when the data is reused, and
+ * checked at that point.
+ */
+bool bbn_data_check_required(void) {
+    // only the keys actually received can be used, or shown
+    if (g_bbn_data.fp_count > g_bbn_data.fp_list.len / 32 ||
+        g_bbn_data.cov_key_count > g_bbn_data.cov_key_list.len / 32) {
+        PRINTF("Fewer keys than announced\n");
+        return false;
+    }
+    return !BBN_DATA_HAS(BBN_FIELD_ACTION_TYPE) || bbn_data_has_required(g_bbn_data.action_type);
+}
+
+/**
+ * The timelock in the scripts of the given action. A delegation locks its staking output for the
+ * staking time, but its unbonding output, and the change of its slashing transactions, for the
+ * unbonding time: with tag 0x72, one parameter set holds both, and covers every transaction.
+ */
+uint64_t bbn_data_timelock(uint32_t action_type) {
+    if (BBN_DATA_HAS(BBN_FIELD_UNBONDING_TIMELOCK) && action_type < BBN_POLICY_COUNT &&
+        (BBN_BUNDLE_UNBONDING_ACTIONS & (1 << action_type)) != 0) {
+        return g_bbn_data.unbonding_timelock;
+    }
+    return g_bbn_data.timelock;
+}
+
+// The index-th 32-byte key of a key list, or NULL if fewer keys were received
+static const uint8_t *bbn_data_key(const bbn_data_slice_t *slice, size_t index) {
+    if (index >= slice->len / 32) {
+        return NULL;
+    }
+    return g_bbn_data_pool + slice->offset + 32 * index;
+}
+
+// The finality provider keys, contiguous
+const uint8_t *bbn_data_fp_keys(void) {
+    return g_bbn_data_pool + g_bbn_data.fp_list.offset;
+}
+
+const uint8_t *bbn_data_fp_key(size_t index) {
+    return bbn_data_key(&g_bbn_data.fp_list, index);
+}
+
+// The covenant keys, contiguous
+const uint8_t *bbn_data_cov_keys(void) {
+    return g_bbn_data_pool + g_bbn_data.cov_key_list.offset;
+}
+
+const uint8_t *bbn_data_cov_key(size_t index) {
+    return bbn_data_key(&g_bbn_data.cov_key_list, index);
+}
+
+// The start of the message to sign, of g_bbn_data.message.len bytes, which is the whole message
+// unless it is longer than MAX_MESSAGE_LEN; it is not NUL-terminated
+const uint8_t *bbn_data_message(void) {
+    return g_bbn_data_pool + g_bbn_data.message.offset;
+}
@@ -2,6 +2,7 @@
 
 #include <stdint.h>
 #include <stdbool.h>
+#include <stddef.h>
 #include "../bitcoin_app_base/src/handler/lib/get_merkleized_map.h"
 #ifndef BBN_DATA_DEF_H
 #define BBN_DATA_DEF_H
@@ -14,6 +15,7 @@
 #define TAG_STAKER_PK           0x51
 #define TAG_COV_QUORUM          0x01
 #define TAG_TIMELOCK            0x71
+#define TAG_UNBONDING_TIMELOCK  0x72
 #define TAG_SLASHING_FEE_LIMIT  0xfe
 #define TAG_UNBONDING_FEE_LIMIT 0xff
 #define TAG_MESSAGE             0x33
@@ -33,58 +35,102 @@
 
 #define MAX_FP_COUNT      16
 #define MAX_COV_KEY_COUNT 16
-
+#define MAX_MESSAGE_LEN   256  // longest message kept, and shown, in full; longer ones are hashed
+
+// Most bytes of variable-size values in a parameter set: the largest key lists and message together
+#define BBN_DATA_POOL_SIZE (MAX_FP_COUNT * 32 + MAX_COV_KEY_COUNT * 32 + MAX_MESSAGE_LEN)
+
+// The values of the TLV data, one bit each in bbn_data_t.fields
+typedef enum {
+    BBN_FIELD_ACTION_TYPE = 0,
+    BBN_FIELD_FP_COUNT,
+    BBN_FIELD_FP_LIST,
+    BBN_FIELD_COV_KEY_COUNT,
+    BBN_FIELD_COV_KEY_LIST,
+    BBN_FIELD_STAKER_PK,
+    BBN_FIELD_COV_QUORUM,
+    BBN_FIELD_FP_QUORUM,
+    BBN_FIELD_TIMELOCK,
+    BBN_FIELD_UNBONDING_TIMELOCK,
+    BBN_FIELD_BURN_ADDRESS,
+    BBN_FIELD_SLASHING_FEE_LIMIT,
+    BBN_FIELD_UNBONDING_FEE_LIMIT,
+    BBN_FIELD_MESSAGE,
+    BBN_FIELD_MESSAGE_KEY,
+    BBN_FIELD_TXID,
+    BBN_FIELD_BIP32_PATH,
+    BBN_FIELD_COUNT
+} bbn_field_t;
+
+#define BBN_FIELD(field) ((uint32_t) 1 << (field))
+
+// The fields each action needs. The staker key is not among them: it is derived when signing.
+#define BBN_REQUIRED_FP_KEYS (BBN_FIELD(BBN_FIELD_FP_COUNT) | BBN_FIELD(BBN_FIELD_FP_LIST))
+#define BBN_REQUIRED_COV_KEYS                                                  \
+    (BBN_FIELD(BBN_FIELD_COV_KEY_COUNT) | BBN_FIELD(BBN_FIELD_COV_KEY_LIST) | \
+     BBN_FIELD(BBN_FIELD_COV_QUORUM))
+#define BBN_REQUIRED_STAKING \
+    (BBN_FIELD(BBN_FIELD_TIMELOCK) | BBN_REQUIRED_FP_KEYS | BBN_REQUIRED_COV_KEYS)
+#define BBN_REQUIRED_UNBOND                                         \
+    (BBN_FIELD(BBN_FIELD_TIMELOCK) | BBN_REQUIRED_COV_KEYS |        \
+     BBN_FIELD(BBN_FIELD_UNBONDING_FEE_LIMIT))
+#define BBN_REQUIRED_SLASHING                                       \
+    (BBN_REQUIRED_STAKING | BBN_FIELD(BBN_FIELD_BURN_ADDRESS) |     \
+     BBN_FIELD(BBN_FIELD_SLASHING_FEE_LIMIT))
+#define BBN_REQUIRED_WITHDRAW BBN_FIELD(BBN_FIELD_TIMELOCK)
+#define BBN_REQUIRED_MESSAGE  BBN_FIELD(BBN_FIELD_MESSAGE)
+
+// A variable-size value, stored in the pool of its parameter set
+typedef struct {
+    uint16_t offset;
+    uint16_t len;
+} bbn_data_slice_t;
+
+/**
+ * The parsed parameters, except the variable-size values (key lists and message): those are packed
+ * in the order they were received in the pool of the parameter set, which is its entry in the
+ * session cache (see bbn_session.c). A parameter set is this structure followed by its pool.
+ */
 typedef struct {
+    uint32_t fields;  // bitmask over bbn_field_t, of the values received
+
     // Action Type
-    bool has_action_type;
     uint8_t action_type;
 
     // Finality Provider
-    bool has_fp_count;
     uint8_t fp_count;
-    bool has_fp_list;
-    uint8_t fp_list[MAX_FP_COUNT][32];
+    bbn_data_slice_t fp_list;
 
     // Covenant Keys
-    bool has_cov_key_count;
     uint8_t cov_key_count;
-    bool has_cov_key_list;
-    uint8_t cov_key_list[MAX_COV_KEY_COUNT][32];
+    bbn_data_slice_t cov_key_list;
 
     // Staker Public Key
-    bool has_staker_pk;
     uint8_t staker_pk[32];
 
     // Covenant Quorum
-    bool has_cov_quorum;
     uint8_t cov_quorum;
 
-    bool has_fp_quorum;
     uint8_t fp_quorum;
 
     // Timelocks
-    bool has_timelock;
     uint64_t timelock;
+    uint64_t unbonding_timelock;  // of the slashing and unbonding scripts, if not timelock
 
-    bool has_burn_address;
     uint8_t burn_address[32];
     uint32_t burn_address_len;
 
     // Fee Limits
-    bool has_slashing_fee_limit;
     uint64_t slashing_fee_limit;
-    bool has_unbonding_fee_limit;
     uint64_t unbonding_fee_limit;
 
-    bool has_message;
-    uint8_t message[256];
-    uint32_t message_len;
+    bbn_data_slice_t message;  // the first MAX_MESSAGE_LEN bytes at most
+    uint16_t message_len;      // length of the whole message
+    uint8_t message_hash[32];  // BIP-322 tagged hash of the whole message
 
-    bool has_message_key;
     uint8_t message_key[32];
     uint32_t message_key_len;
 
-    bool has_txid;
     uint8_t txid[32];
 
     uint8_t g_input_scriptPubKey[32];
@@ -92,9 +138,29 @@ typedef struct {
     merkleized_map_commitment_t output_map;
     uint32_t derive_path[5];
     uint8_t derive_path_len;
+
+    uint16_t pool_len;  // bytes of the pool in use
 } bbn_data_t;
 
+#define BBN_DATA_HEADER_SIZE sizeof(bbn_data_t)
+
+#define BBN_DATA_HAS(field) ((g_bbn_data.fields & BBN_FIELD(field)) != 0)
+
 // 全局变量声明
 extern bbn_data_t g_bbn_data;
 
+void bbn_data_set_pool(uint8_t *pool, uint16_t size);
+uint8_t *bbn_data_pool(void);
+uint8_t *bbn_data_pool_alloc(bbn_data_slice_t *slice, uint16_t len);
+bool bbn_data_has_fields(uint32_t mask);
+bool bbn_data_has_required(uint32_t action_type);
+bool bbn_data_check_required(void);
+uint64_t bbn_data_timelock(uint32_t action_type);
+
+const uint8_t *bbn_data_fp_keys(void);
+const uint8_t *bbn_data_fp_key(size_t index);
+const uint8_t *bbn_data_cov_keys(void);
+const uint8_t *bbn_data_cov_key(size_t index);
+const uint8_t *bbn_data_message(void);
+
 #endif  // BBN_DATA_DEF_H
\ No newline at end of file
@@ -5,6 +5,35 @@
 #define CHUNK_SIZE      64
 #define MAX_CHUNK_COUNT 15
 
+// INS_CUSTOM_TLV sub-commands, sent in P1
+#define BBN_TLV_P1_UPLOAD 0x00  // upload and parse a new parameter set
+#define BBN_TLV_P1_REUSE  0x01  // reload a parameter set parsed earlier in this session
+#define BBN_TLV_P1_BUNDLE 0x02  // sign several transactions with a parameter set, reviewed once
+
+// Debug builds only: dump the trace of the signing phases (see bbn_trace.h)
+#define BBN_TLV_P1_DEBUG_TRACE 0xd0
+#define BBN_TRACE_P2_RESET     0x01  // clear the trace once it has been read
+
+// Debug builds only: report the stack high-water mark of each handler (see bbn_stack.h)
+#define BBN_TLV_P1_DEBUG_STACK 0xd1
+#define BBN_STACK_P2_RESET     0x01  // clear the peaks once they have been read
+
+// Debug builds only: check the tagged hash midstates against the SDK (see bbn_hash.h)
+#define BBN_TLV_P1_DEBUG_HASH 0xd2
+
+// INS_CUSTOM_TLV protocol versions, sent in P2
+#define BBN_TLV_VERSION_0       0  // fixed CHUNK_SIZE leaves
+#define BBN_TLV_VERSION_CHUNKED 1  // chunk size announced by the host after the merkle root
+#define BBN_TLV_VERSION_BULK    2  // as version 1, but all leaves are streamed in order, no proofs
+
+// Client command asking the host for the leaves of the TLV merkle tree, starting at a given index
+#define BBN_CCMD_GET_LEAVES 0x50
+
+// Largest leaf that fits in a single GET_PREIMAGE response: 255 bytes of APDU payload, minus the
+// preimage length, the partial length and the 0x00 leaf prefix.
+#define BBN_MAX_CHUNK_SIZE   252
+#define BBN_MAX_TLV_DATA_LEN 8192  // mostly for long messages, which are not kept in RAM
+
 #define BBN_POLICY_NAME_SLASHING           "Consent to slashing"
 #define BBN_POLICY_NAME_SLASHING_UNBONDING "Consent to unbonding slashing"
 #define BBN_POLICY_NAME_STAKE_TRANSFER     "Staking transaction"
@@ -26,9 +55,23 @@ typedef enum {
     BBN_POLICY_UNBOND,
     BBN_POLICY_WITHDRAW,
     BBN_POLICY_BIP322,
-    BBN_POLICY_EXPANSION
+    BBN_POLICY_EXPANSION,
+    BBN_POLICY_COUNT
 } bbn_action_type_t;
 
+// Sets of actions are uint8_t masks, one bit (1 << action_type) each
+_Static_assert(BBN_POLICY_COUNT <= 8, "too many actions for a uint8_t action mask");
+
+// Actions that can be signed together in a bundle: the transactions of one delegation
+#define BBN_BUNDLE_ACTIONS                                                         \
+    ((1 << BBN_POLICY_STAKE_TRANSFER) | (1 << BBN_POLICY_SLASHING) |              \
+     (1 << BBN_POLICY_UNBOND) | (1 << BBN_POLICY_SLASHING_UNBONDING))
+
+// Actions whose scripts use the unbonding timelock, when the parameters give one
+#define BBN_BUNDLE_UNBONDING_ACTIONS                                               \
+    ((1 << BBN_POLICY_SLASHING) | (1 << BBN_POLICY_UNBOND) |                      \
+     (1 << BBN_POLICY_SLASHING_UNBONDING))
+
 // Atomic byte constants
 #define TX_VER_BYTES 0x00, 0x00, 0x00, 0x00
 #define TX_IN_CNT    0x01
@@ -0,0 +1,102 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include "../bitcoin_app_base/src/crypto.h"
+#include "bbn_hash.h"
+
+/**
+ * SHA-256 state words after compressing SHA256(tag) || SHA256(tag), for each bbn_tag_t. They are
+ * loaded in the accumulator of the context, which holds the state words in native byte order.
+ */
+static const uint32_t g_tag_midstates[BBN_TAG_COUNT][8] = {
+    [BBN_TAG_BIP322_MESSAGE] = {0x896e65a6,
+                                0x9e182133,
+                                0x9aa0d959,
+                                0xa7b9defc,
+                                0x733cba8c,
+                                0x972f0214,
+                                0x5e48b86f,
+                                0xf83bf99c},
+    [BBN_TAG_TAPLEAF] = {0x9ce0e4e6,
+                         0x7c116c39,
+                         0x38b3caf2,
+                         0xc30f5089,
+                         0xd3f3936c,
+                         0x47636e60,
+                         0x7db33eea,
+                         0xddc6f0c9},
+    [BBN_TAG_TAPBRANCH] = {0x23a865a9,
+                           0xb8a40da7,
+                           0x977c1e04,
+                           0xc49e246f,
+                           0xb5be1376,
+                           0x9d24c9b7,
+                           0xb583b5d4,
+                           0xa8d226d2},
+    [BBN_TAG_TAPTWEAK] = {0xd129a2f3,
+                          0x701c655d,
+                          0x6583b6c3,
+                          0xb9419727,
+                          0x95f4e232,
+                          0x94fd54f4,
+                          0xa2ae8d85,
+                          0x47ca590b},
+};
+
+void bbn_tagged_hash_init(cx_sha256_t *hash_context, bbn_tag_t tag) {
+    cx_sha256_init(hash_context);
+    memcpy(hash_context->acc, g_tag_midstates[tag], sizeof(g_tag_midstates[tag]));
+    // one block compressed, none pending: the length padded by the final block is 64 bytes more
+    hash_context->header.counter = 1;
+    hash_context->blen = 0;
+}
+
+#ifdef HAVE_BBN_HASH_SELFTEST
+// Arrays rather than pointers, so that the table needs no relocation on the device
+static const char g_tag_names[BBN_TAG_COUNT][24] = {
+    [BBN_TAG_BIP322_MESSAGE] = "BIP0322-signed-message",
+    [BBN_TAG_TAPLEAF] = "TapLeaf",
+    [BBN_TAG_TAPBRANCH] = "TapBranch",
+    [BBN_TAG_TAPTWEAK] = "TapTweak",
+};
+
+uint8_t bbn_tagged_hash_selftest(const uint8_t *data,
+                                 size_t data_len,
+                                 uint8_t out[static BBN_TAG_COUNT * 32]) {
+    cx_sha256_t hash_context;
+    uint8_t expected[32];
+    uint8_t mismatch = 0;
+
+    for (int tag = 0; tag < BBN_TAG_COUNT; tag++) {
+        crypto_tr_tagged_hash_init(&hash_context,
+                                   (const uint8_t *) g_tag_names[tag],
+                                   strlen(g_tag_names[tag]));
+        crypto_hash_update(&hash_context.header, data, data_len);
+        crypto_hash_digest(&hash_context.header, expected, 32);
+
+        bbn_tagged_hash_init(&hash_context, tag);
+        crypto_hash_update(&hash_context.header, data, data_len);
+        crypto_hash_digest(&hash_context.header, out + 32 * tag, 32);
+
+        if (memcmp(out + 32 * tag, expected, 32) != 0) {
+            mismatch |= 1 << tag;
+        }
+    }
+    return mismatch;
+}
+#endif
+
+void bbn_tapbranch_hash(const uint8_t left[static 32],
+                        const uint8_t right[static 32],
+                        uint8_t out[static 32]) {
+    if (memcmp(right, left, 32) < 0) {
+        const uint8_t *tmp = left;
+        left = right;
+        right = tmp;
+    }
+    cx_sha256_t hash_context;
+    bbn_tagged_hash_init(&hash_context, BBN_TAG_TAPBRANCH);
+    crypto_hash_update(&hash_context.header, left, 32);
+    crypto_hash_update(&hash_context.header, right, 32);
+    crypto_hash_digest(&hash_context.header, out, 32);
+}
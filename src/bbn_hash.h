@@ -0,0 +1,45 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "lib_standard_app/crypto_helpers.h"
+
+#ifndef BBN_HASH_H
+#define BBN_HASH_H
+
+// Tags of the BIP-340 tagged hashes computed by the Babylon modules
+typedef enum {
+    BBN_TAG_BIP322_MESSAGE = 0,  // "BIP0322-signed-message"
+    BBN_TAG_TAPLEAF,             // "TapLeaf"
+    BBN_TAG_TAPBRANCH,           // "TapBranch"
+    BBN_TAG_TAPTWEAK,            // "TapTweak"
+    BBN_TAG_COUNT
+} bbn_tag_t;
+
+/**
+ * Starts a tagged hash, i.e. SHA256(SHA256(tag) || SHA256(tag) || data), from the precomputed
+ * SHA-256 state after its first 64-byte block: the same as crypto_tr_tagged_hash_init, without
+ * hashing the tag and compressing that block again.
+ */
+void bbn_tagged_hash_init(cx_sha256_t *hash_context, bbn_tag_t tag);
+
+// TapBranch hash of two child hashes, sorted as in BIP-341
+void bbn_tapbranch_hash(const uint8_t left[static 32],
+                        const uint8_t right[static 32],
+                        uint8_t out[static 32]);
+
+#ifdef HAVE_BBN_HASH_SELFTEST
+/**
+ * Debug builds only: checks the midstates against the SDK on the device itself. Hashes data with
+ * each tag, both from its midstate and with crypto_tr_tagged_hash_init, writes the digests of the
+ * midstates to out (BBN_TAG_COUNT digests, in bbn_tag_t order), and returns the bitmask of the
+ * tags whose two digests differ.
+ */
+uint8_t bbn_tagged_hash_selftest(const uint8_t *data,
+                                 size_t data_len,
+                                 uint8_t out[static BBN_TAG_COUNT * 32]);
+#endif
+
+#endif  // BBN_HASH_H
@@ -0,0 +1,115 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include "lib_standard_app/crypto_helpers.h"
+#include "../bitcoin_app_base/src/common/bip32.h"
+#include "../bitcoin_app_base/src/crypto.h"
+#include "bbn_def.h"
+#include "bbn_keycache.h"
+#include "bbn_trace.h"
+
+static bbn_keycache_t g_bbn_keycache;
+
+// Makes the cache hold the given path, dropping everything derived for another one
+static bool bbn_keycache_select_path(const uint32_t *path, size_t path_len) {
+    if (path_len > BBN_KEYCACHE_MAX_PATH_LEN) {
+        return false;
+    }
+    if (g_bbn_keycache.path_len == path_len &&
+        memcmp(g_bbn_keycache.path, path, path_len * sizeof(uint32_t)) == 0) {
+        return true;
+    }
+    bbn_keycache_clear();
+    g_bbn_keycache.path_len = path_len;
+    memcpy(g_bbn_keycache.path, path, path_len * sizeof(uint32_t));
+    return true;
+}
+
+bool bbn_keycache_get_pubkey(const uint32_t *path,
+                             size_t path_len,
+                             uint8_t out_compressed_pubkey[static 33]) {
+    if (!bbn_keycache_select_path(path, path_len)) {
+        return false;
+    }
+    if (!g_bbn_keycache.has_pubkey) {
+        serialized_extended_pubkey_t xpub;
+        BBN_TRACE_BEGIN(BBN_TRACE_KEY_DERIVATION);
+        if (0 > get_extended_pubkey_at_path(g_bbn_keycache.path,
+                                            g_bbn_keycache.path_len,
+                                            BIP32_PUBKEY_VERSION,
+                                            &xpub)) {
+            PRINTF("Failed getting bip32 pubkey\n");
+            BBN_TRACE_FAIL(BBN_TRACE_KEY_DERIVATION);
+            return false;
+        }
+        BBN_TRACE_END(BBN_TRACE_KEY_DERIVATION);
+        memcpy(g_bbn_keycache.compressed_pubkey, xpub.compressed_pubkey, 33);
+        g_bbn_keycache.has_pubkey = true;
+    }
+    memcpy(out_compressed_pubkey, g_bbn_keycache.compressed_pubkey, 33);
+    return true;
+}
+
+/**
+ * Returns a copy of the signing key for the given path and mode, deriving it on first use. The
+ * caller owns the copy, and must zeroize it when done.
+ */
+bool bbn_keycache_get_signing_key(const uint32_t *path,
+                                  size_t path_len,
+                                  bbn_key_mode_t mode,
+                                  cx_ecfp_private_key_t *out_private_key,
+                                  uint8_t out_xonly_pubkey[static 32]) {
+    if (mode >= BBN_KEY_MODE_COUNT || !bbn_keycache_select_path(path, path_len)) {
+        return false;
+    }
+
+    cx_ecfp_private_key_t *private_key = &g_bbn_keycache.private_key[mode];
+    if (!(g_bbn_keycache.key_valid & (1 << mode))) {
+        cx_ecfp_public_key_t public_key;
+        bool error = false;
+
+        BBN_TRACE_BEGIN(BBN_TRACE_KEY_DERIVATION);
+        do {  // block executed once, only to allow safely breaking out on error
+            if (bip32_derive_init_privkey_256(CX_CURVE_256K1,
+                                              g_bbn_keycache.path,
+                                              g_bbn_keycache.path_len,
+                                              private_key,
+                                              NULL) != CX_OK) {
+                error = true;
+                break;
+            }
+            if (mode == BBN_KEY_BIP86) {
+                // BIP-86: tweak with the hash of the internal key alone, no tweak data
+                uint8_t no_tweak_data[1];
+                crypto_tr_tweak_seckey(private_key->d, no_tweak_data, 0, private_key->d);
+            }
+            if (cx_ecfp_generate_pair_no_throw(CX_CURVE_256K1, &public_key, private_key, 1) !=
+                CX_OK) {
+                error = true;
+            }
+        } while (false);
+        BBN_TRACE_CLOSE(BBN_TRACE_KEY_DERIVATION, !error);
+
+        if (error) {
+            explicit_bzero(private_key, sizeof(cx_ecfp_private_key_t));
+            return false;
+        }
+        // x-only pubkey, hence take only the x-coordinate
+        memcpy(g_bbn_keycache.xonly_pubkey[mode], public_key.W + 1, 32);
+        g_bbn_keycache.key_valid |= 1 << mode;
+    }
+
+    memcpy(out_private_key, private_key, sizeof(cx_ecfp_private_key_t));
+    memcpy(out_xonly_pubkey, g_bbn_keycache.xonly_pubkey[mode], 32);
+    return true;
+}
+
+void bbn_keycache_wipe_private(void) {
+    explicit_bzero(g_bbn_keycache.private_key, sizeof(g_bbn_keycache.private_key));
+    explicit_bzero(g_bbn_keycache.xonly_pubkey, sizeof(g_bbn_keycache.xonly_pubkey));
+    g_bbn_keycache.key_valid = 0;
+}
+
+void bbn_keycache_clear(void) {
+    explicit_bzero(&g_bbn_keycache, sizeof(g_bbn_keycache));
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "lib_standard_app/crypto_helpers.h"
+
+#ifndef BBN_KEYCACHE_H
+#define BBN_KEYCACHE_H
+
+#define BBN_KEYCACHE_MAX_PATH_LEN 5
+
+// Signing keys kept by the cache: untweaked (script path), and BIP-86 tweaked (key path)
+typedef enum { BBN_KEY_UNTWEAKED = 0, BBN_KEY_BIP86, BBN_KEY_MODE_COUNT } bbn_key_mode_t;
+
+/**
+ * Key material for the staker derivation path. The public key lives for the whole session; the
+ * private keys are only kept while the inputs of one PSBT are signed, and are wiped right after.
+ */
+typedef struct {
+    bool has_pubkey;
+    uint8_t path_len;
+    uint32_t path[BBN_KEYCACHE_MAX_PATH_LEN];
+    uint8_t compressed_pubkey[33];
+    uint8_t key_valid;  // bitmask over bbn_key_mode_t
+    cx_ecfp_private_key_t private_key[BBN_KEY_MODE_COUNT];
+    uint8_t xonly_pubkey[BBN_KEY_MODE_COUNT][32];
+} bbn_keycache_t;
+
+bool bbn_keycache_get_pubkey(const uint32_t *path,
+                             size_t path_len,
+                             uint8_t out_compressed_pubkey[static 33]);
+bool bbn_keycache_get_signing_key(const uint32_t *path,
+                                  size_t path_len,
+                                  bbn_key_mode_t mode,
+                                  cx_ecfp_private_key_t *out_private_key,
+                                  uint8_t out_xonly_pubkey[static 32]);
+void bbn_keycache_wipe_private(void);
+void bbn_keycache_clear(void);
+
+#endif  // BBN_KEYCACHE_H
@@ -0,0 +1,43 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include "../bitcoin_app_base/src/common/merkle.h"
+#include "bbn_def.h"
+#include "bbn_merkle.h"
+
+_Static_assert(BBN_MAX_TLV_DATA_LEN < (1u << BBN_MERKLE_STREAM_DEPTH),
+               "BBN_MERKLE_STREAM_DEPTH too small for 1-byte chunks of BBN_MAX_TLV_DATA_LEN");
+
+void bbn_merkle_stream_init(bbn_merkle_stream_t *stream) {
+    memset(stream, 0, sizeof(bbn_merkle_stream_t));
+}
+
+bool bbn_merkle_stream_add_leaf(bbn_merkle_stream_t *stream, const uint8_t *leaf, size_t leaf_len) {
+    if (stream->n_subtrees >= BBN_MERKLE_STREAM_DEPTH) {
+        return false;
+    }
+    merkle_compute_element_hash(leaf, leaf_len, stream->subtree_roots[stream->n_subtrees++]);
+    stream->n_leaves++;
+
+    // each trailing zero bit of the leaf count closes a complete subtree of twice the size
+    for (uint32_t n = stream->n_leaves; (n & 1) == 0; n >>= 1) {
+        uint8_t *left = stream->subtree_roots[stream->n_subtrees - 2];
+        uint8_t *right = stream->subtree_roots[stream->n_subtrees - 1];
+        merkle_combine_hashes(left, right, left);
+        stream->n_subtrees--;
+    }
+    return true;
+}
+
+bool bbn_merkle_stream_root(const bbn_merkle_stream_t *stream, uint8_t root[static 32]) {
+    if (stream->n_subtrees == 0) {
+        return false;
+    }
+    // the complete subtrees are ordered from the largest to the smallest; fold them from the right
+    memcpy(root, stream->subtree_roots[stream->n_subtrees - 1], 32);
+    for (int i = stream->n_subtrees - 2; i >= 0; i--) {
+        merkle_combine_hashes(stream->subtree_roots[i], root, root);
+    }
+    return true;
+}
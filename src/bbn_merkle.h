@@ -0,0 +1,29 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#ifndef BBN_MERKLE_H
+#define BBN_MERKLE_H
+
+// A stream keeps up to popcount(n - 1) + 1 subtrees while adding its n-th leaf, so 14 slots take
+// up to 16383 leaves: BBN_MAX_TLV_DATA_LEN with 1-byte chunks, checked in bbn_merkle.c.
+#define BBN_MERKLE_STREAM_DEPTH 14
+
+/**
+ * Rebuilds the root of a merkle tree (with the same shape and hashing as the merkle trees of the
+ * client protocol) from its leaves, received in order. Only the roots of the complete subtrees seen
+ * so far are kept, so each leaf and each internal node is hashed exactly once.
+ */
+typedef struct {
+    uint8_t subtree_roots[BBN_MERKLE_STREAM_DEPTH][32];
+    uint8_t n_subtrees;
+    uint32_t n_leaves;
+} bbn_merkle_stream_t;
+
+void bbn_merkle_stream_init(bbn_merkle_stream_t *stream);
+bool bbn_merkle_stream_add_leaf(bbn_merkle_stream_t *stream, const uint8_t *leaf, size_t leaf_len);
+bool bbn_merkle_stream_root(const bbn_merkle_stream_t *stream, uint8_t root[static 32]);
+
+#endif  // BBN_MERKLE_H
@@ -0,0 +1,88 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include "../bitcoin_app_base/src/boilerplate/dispatcher.h"
+#include "../bitcoin_app_base/src/handler/lib/get_merkleized_map.h"
+#include "../bitcoin_app_base/src/handler/sign_psbt.h"
+#include "bbn_def.h"
+#include "bbn_psbt.h"
+
+static bbn_psbt_map_cache_t g_input_maps;
+static bbn_psbt_map_cache_t g_output_maps;
+
+static bbn_psbt_map_entry_t *bbn_psbt_map_cache_find(bbn_psbt_map_cache_t *cache,
+                                                     const uint8_t root[static 32],
+                                                     uint32_t size,
+                                                     uint32_t index) {
+    if (cache->size != size || memcmp(cache->root, root, 32) != 0) {
+        // another PSBT: start over
+        memset(cache, 0, sizeof(bbn_psbt_map_cache_t));
+        memcpy(cache->root, root, 32);
+        cache->size = size;
+        return NULL;
+    }
+    for (int i = 0; i < BBN_PSBT_CACHED_MAPS; i++) {
+        if (cache->entries[i].used && cache->entries[i].index == index) {
+            return &cache->entries[i];
+        }
+    }
+    return NULL;
+}
+
+static void bbn_psbt_map_cache_store(bbn_psbt_map_cache_t *cache,
+                                     uint32_t index,
+                                     const merkleized_map_commitment_t *map) {
+    bbn_psbt_map_entry_t *entry = &cache->entries[cache->next];
+    cache->next = (cache->next + 1) % BBN_PSBT_CACHED_MAPS;
+
+    entry->used = true;
+    entry->index = index;
+    memcpy(&entry->map, map, sizeof(merkleized_map_commitment_t));
+}
+
+/**
+ * Returns the commitment of the map of the given input. It is fetched, and its keys checked, only
+ * the first time it is needed while signing a PSBT.
+ */
+bool bbn_psbt_get_input_map(dispatcher_context_t *dc,
+                            sign_psbt_state_t *st,
+                            uint32_t input_index,
+                            merkleized_map_commitment_t *out_map) {
+    bbn_psbt_map_entry_t *entry =
+        bbn_psbt_map_cache_find(&g_input_maps, st->inputs_root, st->n_inputs, input_index);
+    if (entry != NULL) {
+        memcpy(out_map, &entry->map, sizeof(merkleized_map_commitment_t));
+        return true;
+    }
+
+    if (0 > call_get_merkleized_map(dc, st->inputs_root, st->n_inputs, input_index, out_map)) {
+        PRINTF("Failed to get input map for input %d\n", input_index);
+        return false;
+    }
+    bbn_psbt_map_cache_store(&g_input_maps, input_index, out_map);
+    return true;
+}
+
+/**
+ * Returns the commitment of the map of the given output. As for the inputs, it goes through the
+ * base app's accessor, which checks the keys of the map, and is only fetched the first time it is
+ * needed while signing a PSBT.
+ */
+bool bbn_psbt_get_output_map(dispatcher_context_t *dc,
+                             sign_psbt_state_t *st,
+                             uint32_t output_index,
+                             merkleized_map_commitment_t *out_map) {
+    bbn_psbt_map_entry_t *entry =
+        bbn_psbt_map_cache_find(&g_output_maps, st->outputs_root, st->n_outputs, output_index);
+    if (entry != NULL) {
+        memcpy(out_map, &entry->map, sizeof(merkleized_map_commitment_t));
+        return true;
+    }
+
+    if (0 > call_get_merkleized_map(dc, st->outputs_root, st->n_outputs, output_index, out_map)) {
+        PRINTF("Failed to get output map for output %d\n", output_index);
+        return false;
+    }
+    bbn_psbt_map_cache_store(&g_output_maps, output_index, out_map);
+    return true;
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "../bitcoin_app_base/src/boilerplate/dispatcher.h"
+#include "../bitcoin_app_base/src/handler/sign_psbt.h"
+
+#ifndef BBN_PSBT_H
+#define BBN_PSBT_H
+
+// Number of map commitments kept per map list (inputs or outputs)
+#define BBN_PSBT_CACHED_MAPS 4
+
+typedef struct {
+    bool used;
+    uint32_t index;
+    merkleized_map_commitment_t map;
+} bbn_psbt_map_entry_t;
+
+/**
+ * Map commitments of one list of the PSBT, fetched and checked once and reused until the PSBT
+ * changes. The list is identified by its merkle root, so that nothing outlives a sign_psbt run.
+ */
+typedef struct {
+    uint8_t root[32];
+    uint32_t size;
+    uint8_t next;  // entry replaced by the next miss, round robin
+    bbn_psbt_map_entry_t entries[BBN_PSBT_CACHED_MAPS];
+} bbn_psbt_map_cache_t;
+
+bool bbn_psbt_get_input_map(dispatcher_context_t *dc,
+                            sign_psbt_state_t *st,
+                            uint32_t input_index,
+                            merkleized_map_commitment_t *out_map);
+bool bbn_psbt_get_output_map(dispatcher_context_t *dc,
+                             sign_psbt_state_t *st,
+                             uint32_t output_index,
+                             merkleized_map_commitment_t *out_map);
+
+#endif  // BBN_PSBT_H
@@ -8,14 +8,14 @@
 #include "bbn_script.h"
 #include "bbn_def.h"
 #include "bbn_data.h"
+#include "bbn_keycache.h"
 
 bool bbn_derive_pubkey(uint32_t *bip32_path, uint8_t bip32_path_len, uint8_t *out_pubkey) {
-    serialized_extended_pubkey_t xpub;
-    if (0 > get_extended_pubkey_at_path(bip32_path, bip32_path_len, BIP32_PUBKEY_VERSION, &xpub)) {
-        PRINTF("Failed getting bip32 pubkey\n");
+    uint8_t compressed_pubkey[33];
+    if (!bbn_keycache_get_pubkey(bip32_path, bip32_path_len, compressed_pubkey)) {
         return false;
     }
-    uint8_t *expected_key = xpub.compressed_pubkey + 1;
+    uint8_t *expected_key = compressed_pubkey + 1;
     memcpy(out_pubkey, expected_key, 32);
     return true;
 }
@@ -1,13 +1,18 @@
 #include <stdint.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "lib_standard_app/crypto_helpers.h"
 #include "../bitcoin_app_base/src/common/bitvector.h"
 #include "../bitcoin_app_base/src/common/psbt.h"
 #include "../bitcoin_app_base/src/common/bip32.h"
 #include "../bitcoin_app_base/src/handler/sign_psbt.h"
+#include "bbn_data.h"
+#include "bbn_keycache.h"
+#include "bbn_schnorr.h"
+#include "bbn_trace.h"
 
-#define BBN_CCMD_YIELD 0x10
+#define BBN_CCMD_YIELD       0x10
 
 static bool bbn_yield_signature(dispatcher_context_t *dc,
                                 sign_psbt_state_t *st,
@@ -64,7 +69,7 @@ bool bbn_sign_sighash_schnorr_and_yield(dispatcher_context_t *dc,
     uint8_t sig[64 + 1];  // extra byte for the appended sighash-type, possibly
     size_t sig_len = 0;
 
-    cx_ecfp_public_key_t pubkey_tweaked;  // Pubkey corresponding to the key used for signing
+    uint8_t pubkey_tweaked[32];  // x-only pubkey corresponding to the key used for signing
 
     bool error = false;
     cx_ecfp_private_key_t private_key = {0};
@@ -74,37 +79,41 @@ bool bbn_sign_sighash_schnorr_and_yield(dispatcher_context_t *dc,
 
     do {  // block executed once, only to allow safely breaking out on error
 
-        uint8_t *seckey =
-            private_key.d;  // convenience alias (entirely within the private_key struct)
-
-        if (bip32_derive_init_privkey_256(CX_CURVE_256K1,
-                                          sign_path,
+        // the derivation is shared by all the inputs signed with the same path and tweak
+        bbn_key_mode_t mode =
+            (tweak_data == NULL || tweak_data_len != 0) ? BBN_KEY_UNTWEAKED : BBN_KEY_BIP86;
+        if (!bbn_keycache_get_signing_key(sign_path,
                                           sign_path_len,
+                                          mode,
                                           &private_key,
-                                          NULL) != CX_OK) {
+                                          pubkey_tweaked)) {
             error = true;
             break;
         }
 
-        if (tweak_data != NULL) {
-            crypto_tr_tweak_seckey(seckey, tweak_data, tweak_data_len, seckey);
+        if (tweak_data != NULL && tweak_data_len != 0) {
+            cx_ecfp_public_key_t public_key;
+            BBN_TRACE_BEGIN(BBN_TRACE_TWEAK);
+            crypto_tr_tweak_seckey(private_key.d, tweak_data, tweak_data_len, private_key.d);
+            if (cx_ecfp_generate_pair_no_throw(CX_CURVE_256K1, &public_key, &private_key, 1) !=
+                CX_OK) {
+                BBN_TRACE_FAIL(BBN_TRACE_TWEAK);
+                error = true;
+                break;
+            }
+            BBN_TRACE_END(BBN_TRACE_TWEAK);
+            memcpy(pubkey_tweaked, public_key.W + 1, 32);
         }
 
-        // generate corresponding public key
-        unsigned int err =
-            cx_ecfp_generate_pair_no_throw(CX_CURVE_256K1, &pubkey_tweaked, &private_key, 1);
-        if (err != CX_OK) {
-            error = true;
-            break;
-        }
-
-        err = cx_ecschnorr_sign_no_throw(&private_key,
-                                         CX_ECSCHNORR_BIP0340 | CX_RND_TRNG,
-                                         CX_SHA256,
-                                         sighash,
-                                         32,
-                                         sig,
-                                         &sig_len);
+        BBN_TRACE_BEGIN(BBN_TRACE_SCHNORR_SIGN);
+        unsigned int err = cx_ecschnorr_sign_no_throw(&private_key,
+                                                      CX_ECSCHNORR_BIP0340 | CX_RND_TRNG,
+                                                      CX_SHA256,
+                                                      sighash,
+                                                      32,
+                                                      sig,
+                                                      &sig_len);
+        BBN_TRACE_CLOSE(BBN_TRACE_SCHNORR_SIGN, err == CX_OK);
         if (err != CX_OK) {
             error = true;
         }
@@ -130,16 +139,9 @@ bool bbn_sign_sighash_schnorr_and_yield(dispatcher_context_t *dc,
         sig[sig_len++] = sighash_byte;
     }
 
-    if (!bbn_yield_signature(
-            dc,
-            st,
-            input_index,
-            pubkey_tweaked.W + 1,  // x-only pubkey, hence take only the x-coordinate
-            32,
-            tapleaf_hash,
-            sig,
-            sig_len))
-        return false;
-
-    return true;
+    BBN_TRACE_BEGIN(BBN_TRACE_YIELD);
+    bool yielded =
+        bbn_yield_signature(dc, st, input_index, pubkey_tweaked, 32, tapleaf_hash, sig, sig_len);
+    BBN_TRACE_CLOSE(BBN_TRACE_YIELD, yielded);
+    return yielded;
 }
\ No newline at end of file
@@ -8,4 +8,5 @@ bool bbn_sign_sighash_schnorr_and_yield(dispatcher_context_t *dc,
                                         size_t tweak_data_len,
                                         const uint8_t *tapleaf_hash,
                                         uint8_t sighash_byte,
-                                        const uint8_t sighash[static 32]);
\ No newline at end of file
+                                        const uint8_t sighash[static 32]);
+
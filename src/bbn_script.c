@@ -7,11 +7,10 @@
 #include "../bitcoin_app_base/src/common/merkle.h"
 #include "bbn_def.h"
 #include "bbn_data.h"
+#include "bbn_hash.h"
 #include "bbn_script.h"
-
-static const uint8_t BIP0322_msghash_tag[] = {'B', 'I', 'P', '0', '3', '2', '2', '-',
-                                              's', 'i', 'g', 'n', 'e', 'd', '-', 'm',
-                                              'e', 's', 's', 'a', 'g', 'e'};
+#include "bbn_taptree.h"
+#include "bbn_trace.h"
 
 int bbn_convert_bits(uint8_t *out,
                      size_t *outlen,
@@ -41,219 +40,278 @@ int bbn_convert_bits(uint8_t *out,
     return 1;
 }
 
-static void bbn_leafhash_compute(uint8_t *tapscript, int tapscript_len, uint8_t *leafhash) {
-    cx_sha256_t hash_context;
-    crypto_tr_tapleaf_hash_init(&hash_context);
-    crypto_hash_update_u8(&hash_context.header, 0xC0);
-    crypto_hash_update_varint(&hash_context.header, tapscript_len);
-    crypto_hash_update(&hash_context.header, tapscript, tapscript_len);
-    crypto_hash_digest(&hash_context.header, leafhash, 32);
+/**
+ * Babylon leaf script templates. A template is a constant byte string of BBN_TPL_* instructions,
+ * some followed by an argument byte, that one interpreter turns into the script of the current
+ * g_bbn_data. A new version of the Babylon scripts is a new template.
+ */
+typedef enum {
+    BBN_TPL_END = 0,
+    BBN_TPL_OPCODE,      // + opcode: that script opcode, as is
+    BBN_TPL_STAKER_KEY,  // OP_PUSHBYTES_32 <staker key>
+    BBN_TPL_MULTISIG,    // + bbn_tpl_keys_t | flags: the k-of-n check of a key list, see below
+    BBN_TPL_TIMELOCK,    // the timelock, as a minimal script number
+} bbn_tpl_op_t;
+
+typedef enum {
+    BBN_TPL_KEYS_FP = 0,
+    BBN_TPL_KEYS_COV,
+} bbn_tpl_keys_t;
+
+// <key_0> OP_CHECKSIG <key_1> OP_CHECKSIGADD ... <quorum> OP_NUMEQUAL, or with these flags:
+#define BBN_TPL_VERIFY       0x10  // ends with OP_NUMEQUALVERIFY
+#define BBN_TPL_SINGLE       0x20  // a single key is just <key> OP_CHECKSIGVERIFY
+#define BBN_TPL_KEYS_MASK    0x0f
+
+#define OP_0                   0x00
+#define OP_PUSHBYTES_32        0x20
+#define OP_1                   0x51
+#define OP_NUMEQUAL            0x9c
+#define OP_NUMEQUALVERIFY      0x9d
+#define OP_CHECKSIG            0xac
+#define OP_CHECKSIGVERIFY      0xad
+#define OP_CHECKSEQUENCEVERIFY 0xb2
+#define OP_CHECKSIGADD         0xba
+
+// <staker> OP_CHECKSIGVERIFY <FP multisig> VERIFY <covenant multisig>
+static const uint8_t BBN_TPL_SLASHING[] = {BBN_TPL_STAKER_KEY,
+                                           BBN_TPL_OPCODE,
+                                           OP_CHECKSIGVERIFY,
+                                           BBN_TPL_MULTISIG,
+                                           BBN_TPL_KEYS_FP | BBN_TPL_VERIFY | BBN_TPL_SINGLE,
+                                           BBN_TPL_MULTISIG,
+                                           BBN_TPL_KEYS_COV,
+                                           BBN_TPL_END};
+
+// <staker> OP_CHECKSIGVERIFY <covenant multisig>
+static const uint8_t BBN_TPL_UNBONDING[] = {BBN_TPL_STAKER_KEY,
+                                            BBN_TPL_OPCODE,
+                                            OP_CHECKSIGVERIFY,
+                                            BBN_TPL_MULTISIG,
+                                            BBN_TPL_KEYS_COV,
+                                            BBN_TPL_END};
+
+// <staker> OP_CHECKSIGVERIFY <timelock> OP_CHECKSEQUENCEVERIFY
+static const uint8_t BBN_TPL_TIMELOCK_SCRIPT[] = {BBN_TPL_STAKER_KEY,
+                                                  BBN_TPL_OPCODE,
+                                                  OP_CHECKSIGVERIFY,
+                                                  BBN_TPL_TIMELOCK,
+                                                  BBN_TPL_OPCODE,
+                                                  OP_CHECKSEQUENCEVERIFY,
+                                                  BBN_TPL_END};
+
+/**
+ * Tapscript writer. With a NULL hash context only the length is accumulated, so that the same
+ * template can size the script first and then feed it to the TapLeaf hash, without ever holding
+ * the whole script in memory. Consecutive opcodes are gathered in a small buffer and hashed with a
+ * single update, made just before the next key is hashed: a key push and the opcode before it
+ * cost two updates instead of three.
+ */
+typedef struct {
+    cx_sha256_t *hash_context;
+    size_t len;
+    uint8_t pending[8];
+    uint8_t pending_len;
+} bbn_script_emitter_t;
+
+static void emit_flush(bbn_script_emitter_t *emitter) {
+    if (emitter->hash_context != NULL && emitter->pending_len > 0) {
+        crypto_hash_update(&emitter->hash_context->header,
+                           emitter->pending,
+                           emitter->pending_len);
+    }
+    emitter->pending_len = 0;
 }
 
-static int encode_minimal_push(uint32_t value, uint8_t *buffer) {
-    if (value == 0) {
-        buffer[0] = 0x00;
-        return 1;
+static void emit_u8(bbn_script_emitter_t *emitter, uint8_t value) {
+    if (emitter->pending_len == sizeof(emitter->pending)) {
+        emit_flush(emitter);
     }
+    emitter->pending[emitter->pending_len++] = value;
+    emitter->len += 1;
+}
 
-    if (value >= 1 && value <= 15) {
-        buffer[0] = 0x50 + value;
-        return 1;
+static void emit_bytes(bbn_script_emitter_t *emitter, const uint8_t *data, size_t len) {
+    emit_flush(emitter);
+    if (emitter->hash_context != NULL) {
+        crypto_hash_update(&emitter->hash_context->header, data, len);
     }
+    emitter->len += len;
+}
 
-    int size = 0;
-    int is_negative = (value < 0);
-    uint32_t abs_value = (is_negative) ? -value : value;
+// OP_PUSHBYTES_32 <key>
+static void emit_key_push(bbn_script_emitter_t *emitter, const uint8_t *key) {
+    emit_u8(emitter, OP_PUSHBYTES_32);
+    emit_bytes(emitter, key, 32);
+}
 
-    while (abs_value) {
-        buffer[size++] = abs_value & 0xFF;
-        abs_value >>= 8;
+// Small numbers are OP_0 to OP_16, the others a push of their minimal little-endian encoding, as
+// Babylon builds them (AddInt64 of the btcd script builder).
+static void emit_number(bbn_script_emitter_t *emitter, uint32_t value) {
+    if (value == 0) {
+        emit_u8(emitter, OP_0);
+        return;
     }
-
+    if (value <= 16) {
+        emit_u8(emitter, OP_1 - 1 + value);
+        return;
+    }
+    uint8_t buffer[5];
+    uint8_t size = 0;
+    while (value) {
+        buffer[size++] = value & 0xff;
+        value >>= 8;
+    }
+    // the top bit is the sign
     if (buffer[size - 1] & 0x80) {
-        buffer[size++] = is_negative ? 0x80 : 0x00;
-    } else if (is_negative) {
-        buffer[size - 1] |= 0x80;
+        buffer[size++] = 0x00;
+    }
+    emit_u8(emitter, size);
+    for (uint8_t i = 0; i < size; i++) {
+        emit_u8(emitter, buffer[i]);
     }
-
-    return size;
 }
 
-bool compute_bbn_leafhash_slashing(uint8_t *leafhash) {
-    uint8_t tapscript[1024] = {0};
-    int offset = 0;
-
-    tapscript[offset++] = 0x20;
-    if (g_bbn_data.has_staker_pk)
-        memcpy(tapscript + offset, g_bbn_data.staker_pk, 32);
-    else
-        return false;
-
-    offset += 32;
-    tapscript[offset++] = 0xad;
-    tapscript[offset++] = 0x20;
-    if (g_bbn_data.has_fp_list) {
-        if (g_bbn_data.fp_count > MAX_FP_COUNT) {
-            return false;
-        }
-        for (int i = 0; i < g_bbn_data.fp_count; i++) {
-            memcpy(tapscript + offset, g_bbn_data.fp_list[i], 32);
-            offset += 32;
-
-            if (g_bbn_data.fp_count == 1) {
-                tapscript[offset++] = 0xad;
-                break;
-            }
-            if (i == 0)
-                tapscript[offset++] = 0xac;
-            else
-                tapscript[offset++] = 0xba;
-        }
+static bool emit_multisig(bbn_script_emitter_t *emitter, uint8_t arg) {
+    uint8_t count, max_count, quorum;
+    bbn_field_t keys_field, quorum_field;
+    const uint8_t *(*key_at)(size_t index);
+
+    if ((arg & BBN_TPL_KEYS_MASK) == BBN_TPL_KEYS_FP) {
+        count = g_bbn_data.fp_count;
+        max_count = MAX_FP_COUNT;
+        quorum = g_bbn_data.fp_quorum;
+        keys_field = BBN_FIELD_FP_LIST;
+        quorum_field = BBN_FIELD_FP_QUORUM;
+        key_at = bbn_data_fp_key;
     } else {
-        return false;
+        count = g_bbn_data.cov_key_count;
+        max_count = MAX_COV_KEY_COUNT;
+        quorum = g_bbn_data.cov_quorum;
+        keys_field = BBN_FIELD_COV_KEY_LIST;
+        quorum_field = BBN_FIELD_COV_QUORUM;
+        key_at = bbn_data_cov_key;
     }
-    if (g_bbn_data.fp_count > 1) {
-        if (g_bbn_data.has_fp_quorum)
-            tapscript[offset++] = 0x50 + g_bbn_data.fp_quorum;
-        else
-            return false;
-        tapscript[offset++] = 0x9d;
+    if (!BBN_DATA_HAS(keys_field) || count == 0 || count > max_count) {
+        return false;
     }
 
-    if (g_bbn_data.has_cov_key_list) {
-        if (g_bbn_data.cov_key_count > MAX_COV_KEY_COUNT) {
+    for (uint8_t i = 0; i < count; i++) {
+        const uint8_t *key = key_at(i);
+        if (key == NULL) {
             return false;
         }
-        for (int i = 0; i < g_bbn_data.cov_key_count; i++) {
-            tapscript[offset++] = 0x20;
-            memcpy(tapscript + offset, g_bbn_data.cov_key_list[i], 32);
-            offset += 32;
-            if (i == 0)
-                tapscript[offset++] = 0xac;
-            else
-                tapscript[offset++] = 0xba;
+        emit_key_push(emitter, key);
+        if ((arg & BBN_TPL_SINGLE) && count == 1) {
+            emit_u8(emitter, OP_CHECKSIGVERIFY);
+            return true;
         }
-    } else {
-        return false;
+        emit_u8(emitter, i == 0 ? OP_CHECKSIG : OP_CHECKSIGADD);
     }
-    if (g_bbn_data.has_cov_quorum)
-        tapscript[offset++] = 0x50 + g_bbn_data.cov_quorum;
-    else
+    if (!BBN_DATA_HAS(quorum_field)) {
         return false;
-
-    tapscript[offset++] = 0x9c;
-    PRINTF("compute_bbn_leafhash_slashing tapscript length: %d\n", offset);
-    PRINTF_BUF(tapscript, offset);
-    // Compute leaf hash
-    bbn_leafhash_compute(tapscript, offset, leafhash);
+    }
+    emit_number(emitter, quorum);
+    emit_u8(emitter, (arg & BBN_TPL_VERIFY) ? OP_NUMEQUALVERIFY : OP_NUMEQUAL);
     return true;
 }
 
-bool compute_bbn_leafhash_unbonding(uint8_t *leafhash) {
-    uint8_t tapscript[1024] = {0};
-    int offset = 0;
+// Writes the script of a template, or fails if g_bbn_data lacks one of its values.
+static bool emit_template(bbn_script_emitter_t *emitter, const uint8_t *tpl) {
+    for (;;) {
+        switch (*tpl++) {
+            case BBN_TPL_END:
+                emit_flush(emitter);
+                return true;
+            case BBN_TPL_OPCODE:
+                emit_u8(emitter, *tpl++);
+                break;
+            case BBN_TPL_STAKER_KEY:
+                if (!BBN_DATA_HAS(BBN_FIELD_STAKER_PK)) {
+                    PRINTF("No staker pk\n");
+                    return false;
+                }
+                emit_key_push(emitter, g_bbn_data.staker_pk);
+                break;
+            case BBN_TPL_MULTISIG:
+                if (!emit_multisig(emitter, *tpl++)) {
+                    return false;
+                }
+                break;
+            case BBN_TPL_TIMELOCK: {
+                uint64_t timelock = bbn_data_timelock(g_bbn_data.action_type);
+                if (!BBN_DATA_HAS(BBN_FIELD_TIMELOCK) || timelock > UINT32_MAX) {
+                    PRINTF("No timelock found\n");
+                    return false;
+                }
+                emit_number(emitter, (uint32_t) timelock);
+                break;
+            }
+            default:
+                return false;
+        }
+    }
+}
 
-    tapscript[offset++] = 0x20;
-    if (g_bbn_data.has_staker_pk)
-        memcpy(tapscript + offset, g_bbn_data.staker_pk, 32);
-    else
+// Sizes the script with a first dry pass, then streams it into the TapLeaf hash.
+static bool bbn_leafhash_stream(const uint8_t *tpl, uint8_t *leafhash) {
+    bbn_script_emitter_t emitter = {.hash_context = NULL, .len = 0, .pending_len = 0};
+    if (!emit_template(&emitter, tpl)) {
         return false;
+    }
+    PRINTF("tapscript length: %d\n", (int) emitter.len);
 
-    offset += 32;
-    tapscript[offset++] = 0xad;
+    cx_sha256_t hash_context;
+    bbn_tagged_hash_init(&hash_context, BBN_TAG_TAPLEAF);
+    crypto_hash_update_u8(&hash_context.header, 0xC0);
+    crypto_hash_update_varint(&hash_context.header, emitter.len);
 
-    if (g_bbn_data.has_cov_key_list) {
-        if (g_bbn_data.cov_key_count > MAX_COV_KEY_COUNT) {
-            return false;
-        }
-        for (int i = 0; i < g_bbn_data.cov_key_count; i++) {
-            tapscript[offset++] = 0x20;
-            memcpy(tapscript + offset, g_bbn_data.cov_key_list[i], 32);
-            offset += 32;
-            if (i == 0)
-                tapscript[offset++] = 0xac;
-            else
-                tapscript[offset++] = 0xba;
-        }
-    } else {
+    size_t script_len = emitter.len;
+    emitter.hash_context = &hash_context;
+    emitter.len = 0;
+    if (!emit_template(&emitter, tpl) || emitter.len != script_len) {
         return false;
     }
-    if (g_bbn_data.has_cov_quorum)
-        tapscript[offset++] = 0x50 + g_bbn_data.cov_quorum;
-    else
-        return false;
-
-    tapscript[offset++] = 0x9c;
-    PRINTF("compute_bbn_leafhash_unbonding tapscript length: %d\n", offset);
-    PRINTF_BUF(tapscript, offset);
-    // Compute leaf hash
-    bbn_leafhash_compute(tapscript, offset, leafhash);
+    crypto_hash_digest(&hash_context.header, leafhash, 32);
     return true;
 }
 
-bool compute_bbn_leafhash_timelock(uint8_t *leafhash) {
-    PRINTF("compute_bbn_leafhash_timelock\n");
+static bool bbn_leafhash_compute(const uint8_t *tpl, uint8_t *leafhash) {
+    BBN_TRACE_BEGIN(BBN_TRACE_LEAF_HASH);
+    bool result = bbn_leafhash_stream(tpl, leafhash);
+    BBN_TRACE_CLOSE(BBN_TRACE_LEAF_HASH, result);
+    return result;
+}
 
-    uint8_t tapscript[1024] = {0};
-    int offset = 0;
+bool compute_bbn_leafhash_slashing(uint8_t *leafhash) {
+    return bbn_leafhash_compute(BBN_TPL_SLASHING, leafhash);
+}
 
-    tapscript[offset++] = 0x20;
-    if (g_bbn_data.has_staker_pk)
-        memcpy(tapscript + offset, g_bbn_data.staker_pk, 32);
-    else {
-        PRINTF("No timelock has_staker_pk\n");
-        return false;
-    }
+bool compute_bbn_leafhash_unbonding(uint8_t *leafhash) {
+    return bbn_leafhash_compute(BBN_TPL_UNBONDING, leafhash);
+}
 
-    offset += 32;
-    tapscript[offset++] = 0xad;
-
-    uint8_t value_buffer[4];
-    if (g_bbn_data.has_timelock) {
-        int len = encode_minimal_push(g_bbn_data.timelock, value_buffer);
-        if (g_bbn_data.timelock > 15) tapscript[offset++] = len;
-        memcpy(tapscript + offset, value_buffer, len);
-        offset += len;
-        tapscript[offset++] = 0xb2;
-    } else {
-        PRINTF("No timelock found\n");
-        return false;
-    }
-    PRINTF("compute_bbn_leafhash_timelock tapscript length: %d\n", offset);
-    PRINTF_BUF(tapscript, offset);
-    bbn_leafhash_compute(tapscript, offset, leafhash);
-    return true;
+bool compute_bbn_leafhash_timelock(uint8_t *leafhash) {
+    PRINTF("compute_bbn_leafhash_timelock\n");
+    return bbn_leafhash_compute(BBN_TPL_TIMELOCK_SCRIPT, leafhash);
 }
 
 void compute_bbn_merkle_root(uint8_t *roothash) {
-    uint8_t slashing_leafhash[32];
-    uint8_t unbonding_leafhash[32];
-    uint8_t timelock_leafhash[32];
-
-    compute_bbn_leafhash_slashing(slashing_leafhash);
-    compute_bbn_leafhash_unbonding(unbonding_leafhash);
-    compute_bbn_leafhash_timelock(timelock_leafhash);
-
-    uint8_t branch_hash[32];
-    crypto_tr_combine_taptree_hashes(unbonding_leafhash, timelock_leafhash, branch_hash);
+    bbn_taptree_root(BBN_TREE_STAKING, roothash);
+}
 
-    crypto_tr_combine_taptree_hashes(slashing_leafhash, branch_hash, roothash);
+void bbn_bip322_message_hash_init(cx_sha256_t *hash_context) {
+    bbn_tagged_hash_init(hash_context, BBN_TAG_BIP322_MESSAGE);
 }
 
-void compute_bip322_txid_by_message(const uint8_t *message,
-                                    size_t message_len,
-                                    const uint8_t *tappub,
-                                    uint8_t *txid_out) {
+void compute_bip322_txid_by_message_hash(const uint8_t *message_hash,
+                                         const uint8_t *tappub,
+                                         uint8_t *txid_out) {
     uint8_t tx[] = {TX_PREFIX, TX_DUMMY_TXID, TX_MIDFIX, TX_DUMMY_TXID, TX_SUFFIX};
-    cx_sha256_t sighash_context, txhash_context, txid_context;
+    cx_sha256_t txhash_context, txid_context;
     uint8_t hash[32];
 
-    crypto_tr_tagged_hash_init(&sighash_context, BIP0322_msghash_tag, sizeof(BIP0322_msghash_tag));
-
-    crypto_hash_update(&sighash_context.header, message, message_len);
-    crypto_hash_digest(&sighash_context.header, hash, 32);
-
-    memcpy(tx + OFFSET_MSG_HASH, hash, 32);
+    memcpy(tx + OFFSET_MSG_HASH, message_hash, 32);
     memcpy(tx + OFFSET_PUBKEY, tappub, 32);
 
     cx_sha256_init(&txhash_context);
@@ -264,10 +322,9 @@ void compute_bip322_txid_by_message(const uint8_t *message,
     crypto_hash_digest(&txid_context.header, txid_out, 32);
 }
 
-void compute_bip322_txid_by_message_p2wpkh(const uint8_t *message,
-                                           size_t message_len,
-                                           const uint8_t *compressed_pubkey,
-                                           uint8_t *txid_out) {
+void compute_bip322_txid_by_message_hash_p2wpkh(const uint8_t *message_hash,
+                                                const uint8_t *compressed_pubkey,
+                                                uint8_t *txid_out) {
     // Build P2WPKH BIP-322 transaction: prefix + message_hash + midfix + pubkey_hash + suffix
     uint8_t tx[116] = {0};  // Pre-calculated size for P2WPKH transaction
     size_t offset = 0;
@@ -277,8 +334,8 @@ void compute_bip322_txid_by_message_p2wpkh(const uint8_t *message,
     memcpy(tx + offset, tx_prefix, sizeof(tx_prefix));
     offset += sizeof(tx_prefix);
 
-    // Message hash placeholder (32 bytes) - will be filled later
-    uint8_t message_hash_offset = offset;
+    // BIP-322 message hash (32 bytes), the same as for Taproot
+    memcpy(tx + offset, message_hash, 32);
     offset += 32;
 
     // TX_MIDFIX_P2WPKH (16 bytes)
@@ -286,8 +343,8 @@ void compute_bip322_txid_by_message_p2wpkh(const uint8_t *message,
     memcpy(tx + offset, tx_midfix, sizeof(tx_midfix));
     offset += sizeof(tx_midfix);
 
-    // Pubkey hash placeholder (20 bytes) - will be filled later
-    uint8_t pubkey_hash_offset = offset;
+    // Pubkey hash (20 bytes)
+    crypto_hash160(compressed_pubkey, 33, tx + offset);
     offset += 20;
 
     // TX_SUFFIX (4 bytes)
@@ -295,23 +352,41 @@ void compute_bip322_txid_by_message_p2wpkh(const uint8_t *message,
     memcpy(tx + offset, tx_suffix, sizeof(tx_suffix));
     offset += sizeof(tx_suffix);
 
-    cx_sha256_t sighash_context, txhash_context, txid_context;
+    cx_sha256_t txhash_context, txid_context;
     uint8_t hash[32];
 
-    // Create BIP-322 message hash (same as Taproot)
-    crypto_tr_tagged_hash_init(&sighash_context, BIP0322_msghash_tag, sizeof(BIP0322_msghash_tag));
-    crypto_hash_update(&sighash_context.header, message, message_len);
-    crypto_hash_digest(&sighash_context.header, hash, 32);
-    memcpy(tx + message_hash_offset, hash, 32);
-
-    uint8_t pubkey_hash[20];
-    crypto_hash160(compressed_pubkey, 33, pubkey_hash);
-    memcpy(tx + pubkey_hash_offset, pubkey_hash, 20);
-
     cx_sha256_init(&txhash_context);
     crypto_hash_update(&txhash_context.header, tx, offset);
     crypto_hash_digest(&txhash_context.header, hash, 32);
     cx_sha256_init(&txid_context);
     crypto_hash_update(&txid_context.header, hash, 32);
     crypto_hash_digest(&txid_context.header, txid_out, 32);
-}
\ No newline at end of file
+}
+
+// Same as compute_bip322_txid_by_message_hash, for a message held in memory
+void compute_bip322_txid_by_message(const uint8_t *message,
+                                    size_t message_len,
+                                    const uint8_t *tappub,
+                                    uint8_t *txid_out) {
+    cx_sha256_t hash_context;
+    uint8_t message_hash[32];
+
+    bbn_bip322_message_hash_init(&hash_context);
+    crypto_hash_update(&hash_context.header, message, message_len);
+    crypto_hash_digest(&hash_context.header, message_hash, 32);
+    compute_bip322_txid_by_message_hash(message_hash, tappub, txid_out);
+}
+
+// Same as compute_bip322_txid_by_message_hash_p2wpkh, for a message held in memory
+void compute_bip322_txid_by_message_p2wpkh(const uint8_t *message,
+                                           size_t message_len,
+                                           const uint8_t *compressed_pubkey,
+                                           uint8_t *txid_out) {
+    cx_sha256_t hash_context;
+    uint8_t message_hash[32];
+
+    bbn_bip322_message_hash_init(&hash_context);
+    crypto_hash_update(&hash_context.header, message, message_len);
+    crypto_hash_digest(&hash_context.header, message_hash, 32);
+    compute_bip322_txid_by_message_hash_p2wpkh(message_hash, compressed_pubkey, txid_out);
+}
@@ -2,6 +2,9 @@
 
 #include <stdint.h>
 #include <stdbool.h>  // 添加这行
+#include <stddef.h>
+
+#include "lib_standard_app/crypto_helpers.h"
 
 #ifndef BBN_SCRIPT_H
 #define BBN_SCRIPT_H
@@ -14,6 +17,16 @@ bool compute_bbn_leafhash_timelock(uint8_t *leafhash);
 
 void compute_bbn_merkle_root(uint8_t *roothash);
 
+void bbn_bip322_message_hash_init(cx_sha256_t *hash_context);
+
+void compute_bip322_txid_by_message_hash(const uint8_t *message_hash,
+                                         const uint8_t *tappub,
+                                         uint8_t *txid_out);
+
+void compute_bip322_txid_by_message_hash_p2wpkh(const uint8_t *message_hash,
+                                                const uint8_t *compressed_pubkey,
+                                                uint8_t *txid_out);
+
 void compute_bip322_txid_by_message(const uint8_t *message,
                                     size_t message_len,
                                     const uint8_t *tappub,
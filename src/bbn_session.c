@@ -0,0 +1,254 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include "../bitcoin_app_base/src/handler/sign_psbt.h"
+#include "bbn_def.h"
+#include "bbn_data.h"
+#include "bbn_session.h"
+#include "bbn_taptree.h"
+
+/**
+ * Room for the largest parameter set, and for a typical delegation (one finality provider and
+ * up to 10 covenant keys) next to it. Smaller sets share it as long as they fit. The set being
+ * uploaded is parsed straight into the free end of the arena, so that its values are never held
+ * twice: g_bbn_data only holds the fixed fields, and points to its pool in the arena.
+ */
+#define BBN_SESSION_ARENA_SIZE \
+    (2 * BBN_DATA_HEADER_SIZE + BBN_DATA_POOL_SIZE + 11 * 32)
+
+// A cached parameter set: its bbn_data_t, then its pool, stored in the arena
+typedef struct {
+    bool used;
+    uint32_t last_use;
+    uint8_t tlv_hash[32];
+    uint16_t offset;
+    uint16_t len;
+} bbn_session_entry_t;
+
+/**
+ * A set of delegation transactions signed with the same parameters and the same staker key. The
+ * shared parameters are reviewed with the first transaction only.
+ */
+typedef struct {
+    uint8_t action_mask;  // bit (1 << action_type) for each transaction still to be signed
+    bool reviewed;
+    uint8_t tlv_hash[32];
+    uint8_t staker_pk[32];
+} bbn_bundle_t;
+
+static bbn_session_entry_t g_session_cache[BBN_SESSION_CACHE_SIZE];
+static uint32_t g_session_clock;
+
+// the entries are packed at the start of the arena, with no gap between them
+static uint8_t g_session_arena[BBN_SESSION_ARENA_SIZE];
+static size_t g_session_arena_len;
+
+// hash of the TLV data currently in g_bbn_data
+static bool g_has_current;
+static uint8_t g_current_tlv_hash[32];
+
+static bbn_bundle_t g_bundle;
+
+static bbn_session_entry_t *bbn_session_find(const uint8_t tlv_hash[static 32]) {
+    for (int i = 0; i < BBN_SESSION_CACHE_SIZE; i++) {
+        if (g_session_cache[i].used && memcmp(g_session_cache[i].tlv_hash, tlv_hash, 32) == 0) {
+            return &g_session_cache[i];
+        }
+    }
+    return NULL;
+}
+
+/**
+ * Drops an entry, moving down the entries stored after it in the arena. The pool of g_bbn_data
+ * follows if it is one of them; a pool being parsed, past the entries, does not move.
+ */
+static void bbn_session_remove(bbn_session_entry_t *entry) {
+    size_t end = entry->offset + entry->len;
+    uint8_t *pool = bbn_data_pool();
+
+    memmove(g_session_arena + entry->offset, g_session_arena + end, g_session_arena_len - end);
+    if (pool >= g_session_arena + end && pool < g_session_arena + g_session_arena_len) {
+        bbn_data_set_pool(pool - entry->len, g_bbn_data.pool_len);
+    }
+    g_session_arena_len -= entry->len;
+    for (int i = 0; i < BBN_SESSION_CACHE_SIZE; i++) {
+        if (g_session_cache[i].used && g_session_cache[i].offset > entry->offset) {
+            g_session_cache[i].offset -= entry->len;
+        }
+    }
+    entry->used = false;
+}
+
+/**
+ * Evicts the least recently used entries until len bytes are free at the end of the arena, and
+ * if need_entry, one entry too. Returns a free entry, if there is one.
+ */
+static bbn_session_entry_t *bbn_session_make_room(size_t len, bool need_entry) {
+    while (true) {
+        bbn_session_entry_t *free_entry = NULL;
+        bbn_session_entry_t *oldest = NULL;
+        for (int i = 0; i < BBN_SESSION_CACHE_SIZE; i++) {
+            bbn_session_entry_t *entry = &g_session_cache[i];
+            if (!entry->used) {
+                free_entry = entry;
+            } else if (oldest == NULL || entry->last_use < oldest->last_use) {
+                oldest = entry;
+            }
+        }
+        if ((free_entry != NULL || !need_entry) &&
+            g_session_arena_len + len <= sizeof(g_session_arena)) {
+            return free_entry;
+        }
+        // the arena holds the largest parameter set on its own, so this always ends
+        bbn_session_remove(oldest);
+    }
+}
+
+/**
+ * Makes room at the end of the arena for the pool of a parameter set about to be parsed, of at
+ * most pool_len bytes, evicting the least recently used entries if needed, and gives it to
+ * g_bbn_data. The values parsed are then already in place when the set is stored.
+ */
+void bbn_session_reserve_params(size_t pool_len) {
+    if (pool_len > BBN_DATA_POOL_SIZE) {
+        pool_len = BBN_DATA_POOL_SIZE;
+    }
+    bbn_session_make_room(BBN_DATA_HEADER_SIZE + pool_len, false);
+    bbn_data_set_pool(g_session_arena + g_session_arena_len + BBN_DATA_HEADER_SIZE, pool_len);
+}
+
+/**
+ * Saves the freshly parsed g_bbn_data under the hash of its TLV data, evicting the least recently
+ * used entries if the cache is full. Its pool must be the one given by bbn_session_reserve_params.
+ */
+void bbn_session_store_params(const uint8_t tlv_hash[static 32]) {
+    bbn_session_entry_t *entry = bbn_session_find(tlv_hash);
+    uint8_t *pool = bbn_data_pool();
+    size_t len = BBN_DATA_HEADER_SIZE + g_bbn_data.pool_len;
+
+    if (entry != NULL) {
+        if (pool == g_session_arena + entry->offset + BBN_DATA_HEADER_SIZE) {
+            // the set loaded from this entry, with new fields: its values are already there
+            entry->last_use = ++g_session_clock;
+            memcpy(g_session_arena + entry->offset, &g_bbn_data, BBN_DATA_HEADER_SIZE);
+            memcpy(g_current_tlv_hash, tlv_hash, 32);
+            g_has_current = true;
+            return;
+        }
+        bbn_session_remove(entry);
+    }
+    entry = bbn_session_make_room(len, true);
+
+    entry->used = true;
+    entry->last_use = ++g_session_clock;
+    memcpy(entry->tlv_hash, tlv_hash, 32);
+    entry->offset = g_session_arena_len;
+    entry->len = len;
+    // the entries removed were before the pool: it moves down with the end of the arena
+    uint8_t *stored_pool = g_session_arena + entry->offset + BBN_DATA_HEADER_SIZE;
+    if (pool != NULL) {
+        memmove(stored_pool, pool, g_bbn_data.pool_len);
+    }
+    memcpy(g_session_arena + entry->offset, &g_bbn_data, BBN_DATA_HEADER_SIZE);
+    g_session_arena_len += len;
+    bbn_data_set_pool(stored_pool, g_bbn_data.pool_len);
+    memcpy(g_current_tlv_hash, tlv_hash, 32);
+    g_has_current = true;
+}
+
+/**
+ * Restores g_bbn_data from the parameter set with the given TLV hash, as if it was just uploaded.
+ * Its values are read where they are cached.
+ */
+bool bbn_session_load_params(const uint8_t tlv_hash[static 32]) {
+    bbn_session_entry_t *entry = bbn_session_find(tlv_hash);
+
+    if (entry == NULL) {
+        PRINTF("No cached parameters for this hash\n");
+        return false;
+    }
+
+    entry->last_use = ++g_session_clock;
+    memcpy(&g_bbn_data, g_session_arena + entry->offset, BBN_DATA_HEADER_SIZE);
+    bbn_data_set_pool(g_session_arena + entry->offset + BBN_DATA_HEADER_SIZE,
+                      g_bbn_data.pool_len);
+    bbn_taptree_invalidate();
+    memcpy(g_current_tlv_hash, tlv_hash, 32);
+    g_has_current = true;
+    return true;
+}
+
+void bbn_session_clear_current(void) {
+    g_has_current = false;
+}
+
+/**
+ * Starts a bundle for the cached parameter set with the given TLV hash, replacing any previous
+ * one. The parameter set is loaded in g_bbn_data.
+ */
+bool bbn_session_bundle_begin(const uint8_t tlv_hash[static 32], uint8_t action_mask) {
+    memset(&g_bundle, 0, sizeof(g_bundle));
+
+    if (action_mask == 0 || (action_mask & ~BBN_BUNDLE_ACTIONS) != 0) {
+        PRINTF("Invalid bundle actions: 0x%x\n", action_mask);
+        return false;
+    }
+    if (!bbn_session_load_params(tlv_hash)) {
+        return false;
+    }
+    // the parameters must do for every action of the bundle
+    for (uint32_t action = 0; action < BBN_POLICY_COUNT; action++) {
+        if ((action_mask & (1 << action)) && !bbn_data_has_required(action)) {
+            return false;
+        }
+    }
+    // the staking output and the unbonding ones are not locked for the same time
+    if ((action_mask & (1 << BBN_POLICY_STAKE_TRANSFER)) &&
+        (action_mask & BBN_BUNDLE_UNBONDING_ACTIONS) &&
+        !BBN_DATA_HAS(BBN_FIELD_UNBONDING_TIMELOCK)) {
+        PRINTF("No unbonding timelock for the bundle\n");
+        return false;
+    }
+
+    g_bundle.action_mask = action_mask;
+    memcpy(g_bundle.tlv_hash, tlv_hash, 32);
+    return true;
+}
+
+uint8_t bbn_session_bundle_actions(void) {
+    return g_bundle.action_mask;
+}
+
+bbn_bundle_state_t bbn_session_bundle_state(uint32_t action_type,
+                                            const uint8_t staker_pk[static 32]) {
+    if (action_type >= BBN_POLICY_COUNT || !(g_bundle.action_mask & (1 << action_type)) ||
+        !g_has_current || memcmp(g_current_tlv_hash, g_bundle.tlv_hash, 32) != 0) {
+        return BBN_BUNDLE_NONE;
+    }
+    if (!g_bundle.reviewed) {
+        return BBN_BUNDLE_PENDING_REVIEW;
+    }
+    // the approval only holds for the key it was given for
+    if (memcmp(g_bundle.staker_pk, staker_pk, 32) != 0) {
+        return BBN_BUNDLE_NONE;
+    }
+    return BBN_BUNDLE_REVIEWED;
+}
+
+/**
+ * Records that the transaction for the given action was approved. The bundle ends once every
+ * transaction has been through.
+ */
+void bbn_session_bundle_consume(uint32_t action_type, const uint8_t staker_pk[static 32]) {
+    if (bbn_session_bundle_state(action_type, staker_pk) == BBN_BUNDLE_NONE) {
+        return;
+    }
+    if (!g_bundle.reviewed) {
+        g_bundle.reviewed = true;
+        memcpy(g_bundle.staker_pk, staker_pk, 32);
+    }
+    g_bundle.action_mask &= ~(1 << action_type);
+    if (g_bundle.action_mask == 0) {
+        memset(&g_bundle, 0, sizeof(g_bundle));
+    }
+}
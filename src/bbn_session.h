@@ -0,0 +1,31 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#ifndef BBN_SESSION_H
+#define BBN_SESSION_H
+
+// Most parsed parameter sets kept in RAM, each keyed by the SHA-256 of its TLV data. Fewer are
+// kept if they do not fit in the cache together (see bbn_session.c).
+#define BBN_SESSION_CACHE_SIZE 4
+
+typedef enum {
+    BBN_BUNDLE_NONE = 0,        // not part of a bundle: the transaction is reviewed on its own
+    BBN_BUNDLE_PENDING_REVIEW,  // first transaction of a bundle: the whole bundle is reviewed
+    BBN_BUNDLE_REVIEWED         // the shared parameters were already approved for this bundle
+} bbn_bundle_state_t;
+
+void bbn_session_reserve_params(size_t pool_len);
+void bbn_session_store_params(const uint8_t tlv_hash[static 32]);
+bool bbn_session_load_params(const uint8_t tlv_hash[static 32]);
+void bbn_session_clear_current(void);
+
+bool bbn_session_bundle_begin(const uint8_t tlv_hash[static 32], uint8_t action_mask);
+uint8_t bbn_session_bundle_actions(void);
+bbn_bundle_state_t bbn_session_bundle_state(uint32_t action_type,
+                                            const uint8_t staker_pk[static 32]);
+void bbn_session_bundle_consume(uint32_t action_type, const uint8_t staker_pk[static 32]);
+
+#endif  // BBN_SESSION_H
@@ -0,0 +1,86 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include "os.h"
+#include "bbn_stack.h"
+
+#ifdef HAVE_BBN_STACK_PROFILE
+
+// Bounds of the app stack, from the SDK linker script. The stack grows down from _estack; the
+// word at _stack may hold the stack canary, and is never painted.
+extern unsigned int _stack;
+extern unsigned int _estack;
+
+#define BBN_STACK_PAINT 0xa5a5a5a5u
+
+// Words left unpainted right below the frame of bbn_stack_enter, for the calls it makes
+#define BBN_STACK_PAINT_MARGIN 16
+
+// Deepest stack usage seen in each handler, in bytes from the top of the stack
+static uint32_t g_bbn_stack_peak[BBN_STACK_HANDLER_COUNT];
+
+static uint32_t bbn_stack_size(void) {
+    return (uint32_t) ((uintptr_t) &_estack - (uintptr_t) &_stack);
+}
+
+/**
+ * Fills the unused part of the stack with BBN_STACK_PAINT. A plain loop is used rather than
+ * memset, which would grow the stack over the words being painted.
+ */
+void __attribute__((noinline)) bbn_stack_enter(void) {
+    volatile uint32_t marker = 0;
+    uint32_t *top = (uint32_t *) &marker - BBN_STACK_PAINT_MARGIN;
+
+    for (volatile uint32_t *word = (uint32_t *) &_stack + 1; word < top; word++) {
+        *word = BBN_STACK_PAINT;
+    }
+}
+
+/**
+ * Finds the lowest word that is not painted anymore: the handler, or anything it called, has
+ * used the stack down to there.
+ */
+void __attribute__((noinline)) bbn_stack_leave(bbn_stack_handler_t handler) {
+    const uint32_t *word = (const uint32_t *) &_stack + 1;
+
+    while (word < (const uint32_t *) &_estack && *word == BBN_STACK_PAINT) {
+        word++;
+    }
+    uint32_t used = (uint32_t) ((uintptr_t) &_estack - (uintptr_t) word);
+    if (handler < BBN_STACK_HANDLER_COUNT && used > g_bbn_stack_peak[handler]) {
+        g_bbn_stack_peak[handler] = used;
+    }
+    PRINTF("stack: handler %d used %u of %u bytes\n", handler, used, bbn_stack_size());
+}
+
+static size_t write_u32_be(uint8_t *out, uint32_t value) {
+    out[0] = value >> 24;
+    out[1] = (value >> 16) & 0xff;
+    out[2] = (value >> 8) & 0xff;
+    out[3] = value & 0xff;
+    return 4;
+}
+
+/**
+ * Writes the size of the stack (4 bytes), the number of handlers (1 byte), then the peak usage of
+ * each handler (4 bytes), big-endian. Returns the number of bytes written, or 0 if out is too
+ * small.
+ */
+size_t bbn_stack_report(uint8_t *out, size_t out_len) {
+    if (out_len < 4 + 1 + 4 * BBN_STACK_HANDLER_COUNT) {
+        return 0;
+    }
+
+    size_t len = write_u32_be(out, bbn_stack_size());
+    out[len++] = BBN_STACK_HANDLER_COUNT;
+    for (size_t i = 0; i < BBN_STACK_HANDLER_COUNT; i++) {
+        len += write_u32_be(out + len, g_bbn_stack_peak[i]);
+    }
+    return len;
+}
+
+void bbn_stack_reset(void) {
+    memset(g_bbn_stack_peak, 0, sizeof(g_bbn_stack_peak));
+}
+
+#endif  // HAVE_BBN_STACK_PROFILE
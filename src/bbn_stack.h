@@ -0,0 +1,42 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#ifndef BBN_STACK_H
+#define BBN_STACK_H
+
+// Handlers whose stack usage is profiled
+typedef enum {
+    BBN_STACK_TLV_UPLOAD = 0,  // INS_CUSTOM_TLV upload
+    BBN_STACK_TLV_REUSE,       // INS_CUSTOM_TLV reuse
+    BBN_STACK_TLV_BUNDLE,      // INS_CUSTOM_TLV bundle
+    BBN_STACK_VALIDATE,        // validate_and_display_transaction, UI included
+    BBN_STACK_SIGN_INPUTS,     // sign_custom_inputs
+    BBN_STACK_HANDLER_COUNT
+} bbn_stack_handler_t;
+
+#ifdef HAVE_BBN_STACK_PROFILE
+
+void bbn_stack_enter(void);
+void bbn_stack_leave(bbn_stack_handler_t handler);
+size_t bbn_stack_report(uint8_t *out, size_t out_len);
+void bbn_stack_reset(void);
+
+// Paints the free stack on entry to a handler, and records its high-water mark on exit
+#define BBN_STACK_ENTER(handler) bbn_stack_enter()
+#define BBN_STACK_LEAVE(handler) bbn_stack_leave(handler)
+
+#else
+
+#define BBN_STACK_ENTER(handler) \
+    do {                         \
+    } while (0)
+#define BBN_STACK_LEAVE(handler) \
+    do {                         \
+    } while (0)
+
+#endif  // HAVE_BBN_STACK_PROFILE
+
+#endif  // BBN_STACK_H
@@ -0,0 +1,185 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include "../bitcoin_app_base/src/crypto.h"
+#include "bbn_def.h"
+#include "bbn_data.h"
+#include "bbn_hash.h"
+#include "bbn_script.h"
+#include "bbn_taptree.h"
+#include "bbn_trace.h"
+
+/**
+ * Unspendable internal key used by all Babylon scripts, already lifted to its point with an even y,
+ * uncompressed: 0x04 || x || y. The x-only key is bytes 1 to 32.
+ */
+static const uint8_t NUMS_POINT[65] = {
+    0x04, 0x50, 0x92, 0x9b, 0x74, 0xc1, 0xa0, 0x49,
+    0x54, 0xb7, 0x8b, 0x4b, 0x60, 0x35, 0xe9, 0x7a,
+    0x5e, 0x07, 0x8a, 0x5a, 0x0f, 0x28, 0xec, 0x96,
+    0xd5, 0x47, 0xbf, 0xee, 0x9a, 0xce, 0x80, 0x3a,
+    0xc0, 0x31, 0xd3, 0xc6, 0x86, 0x39, 0x73, 0x92,
+    0x6e, 0x04, 0x9e, 0x63, 0x7c, 0xb1, 0xb5, 0xf4,
+    0x0a, 0x36, 0xda, 0xc2, 0x8a, 0xf1, 0x76, 0x69,
+    0x68, 0xc3, 0x0c, 0x23, 0x13, 0xf3, 0xa3, 0x89,
+    0x04};
+
+// generator and group order of secp256k1
+static const uint8_t SECP256K1_G[65] = {
+    0x04, 0x79, 0xbe, 0x66, 0x7e, 0xf9, 0xdc, 0xbb,
+    0xac, 0x55, 0xa0, 0x62, 0x95, 0xce, 0x87, 0x0b,
+    0x07, 0x02, 0x9b, 0xfc, 0xdb, 0x2d, 0xce, 0x28,
+    0xd9, 0x59, 0xf2, 0x81, 0x5b, 0x16, 0xf8, 0x17,
+    0x98, 0x48, 0x3a, 0xda, 0x77, 0x26, 0xa3, 0xc4,
+    0x65, 0x5d, 0xa4, 0xfb, 0xfc, 0x0e, 0x11, 0x08,
+    0xa8, 0xfd, 0x17, 0xb4, 0x48, 0xa6, 0x85, 0x54,
+    0x19, 0x9c, 0x47, 0xd0, 0x8f, 0xfb, 0x10, 0xd4,
+    0xb8};
+static const uint8_t SECP256K1_N[32] = {
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xfe,
+    0xba, 0xae, 0xdc, 0xe6, 0xaf, 0x48, 0xa0, 0x3b,
+    0xbf, 0xd2, 0x5e, 0x8c, 0xd0, 0x36, 0x41, 0x41};
+
+static bbn_taptree_t g_bbn_taptree;
+
+void bbn_taptree_invalidate(void) {
+    memset(&g_bbn_taptree, 0, sizeof(g_bbn_taptree));
+}
+
+// The memoized hashes and keys are read in place by the functions below, and only copied out by
+// the public functions that fill a buffer of the caller.
+static const uint8_t *bbn_taptree_leafhash_view(bbn_leaf_t leaf) {
+    if (leaf >= BBN_LEAF_COUNT) {
+        return NULL;
+    }
+    if (!(g_bbn_taptree.leaf_valid & (1 << leaf))) {
+        bool ok;
+        switch (leaf) {
+            case BBN_LEAF_SLASHING:
+                ok = compute_bbn_leafhash_slashing(g_bbn_taptree.leafhash[leaf]);
+                break;
+            case BBN_LEAF_UNBONDING:
+                ok = compute_bbn_leafhash_unbonding(g_bbn_taptree.leafhash[leaf]);
+                break;
+            default:
+                ok = compute_bbn_leafhash_timelock(g_bbn_taptree.leafhash[leaf]);
+                break;
+        }
+        if (!ok) {
+            return NULL;
+        }
+        g_bbn_taptree.leaf_valid |= 1 << leaf;
+    }
+    return g_bbn_taptree.leafhash[leaf];
+}
+
+bool bbn_taptree_leafhash(bbn_leaf_t leaf, uint8_t out[static 32]) {
+    const uint8_t *leafhash = bbn_taptree_leafhash_view(leaf);
+    if (leafhash == NULL) {
+        return false;
+    }
+    memcpy(out, leafhash, 32);
+    return true;
+}
+
+static const uint8_t *bbn_taptree_branch_view(void) {
+    if (!g_bbn_taptree.branch_valid) {
+        const uint8_t *unbonding_leafhash = bbn_taptree_leafhash_view(BBN_LEAF_UNBONDING);
+        const uint8_t *timelock_leafhash = bbn_taptree_leafhash_view(BBN_LEAF_TIMELOCK);
+        if (unbonding_leafhash == NULL || timelock_leafhash == NULL) {
+            return NULL;
+        }
+        bbn_tapbranch_hash(unbonding_leafhash, timelock_leafhash, g_bbn_taptree.branch_hash);
+        g_bbn_taptree.branch_valid = 1;
+    }
+    return g_bbn_taptree.branch_hash;
+}
+
+// The timelock tree has a single leaf, which is its root: that root is the leaf hash itself.
+static const uint8_t *bbn_taptree_root_view(bbn_tree_t tree) {
+    if (tree >= BBN_TREE_COUNT) {
+        return NULL;
+    }
+    if (tree == BBN_TREE_TIMELOCK) {
+        return bbn_taptree_leafhash_view(BBN_LEAF_TIMELOCK);
+    }
+    if (!(g_bbn_taptree.root_valid & (1 << tree))) {
+        const uint8_t *slashing_leafhash = bbn_taptree_leafhash_view(BBN_LEAF_SLASHING);
+        const uint8_t *right_hash = tree == BBN_TREE_STAKING
+                                        ? bbn_taptree_branch_view()
+                                        : bbn_taptree_leafhash_view(BBN_LEAF_TIMELOCK);
+        if (slashing_leafhash == NULL || right_hash == NULL) {
+            return NULL;
+        }
+        bbn_tapbranch_hash(slashing_leafhash, right_hash, g_bbn_taptree.root[tree]);
+        g_bbn_taptree.root_valid |= 1 << tree;
+    }
+    return g_bbn_taptree.root[tree];
+}
+
+bool bbn_taptree_root(bbn_tree_t tree, uint8_t out[static 32]) {
+    const uint8_t *root = bbn_taptree_root_view(tree);
+    if (root == NULL) {
+        return false;
+    }
+    memcpy(out, root, 32);
+    return true;
+}
+
+/**
+ * BIP-341 output key of the NUMS internal key and a merkle root: x(P + t*G) with
+ * t = TapTweak(x(P) || root). Starts from the lifted point, where crypto_tr_tweak_pubkey would lift
+ * the x-only key with a modular square root on every call.
+ */
+static bool bbn_taptree_tweak_nums(const uint8_t root[static 32], uint8_t out[static 32]) {
+    cx_sha256_t hash_context;
+    uint8_t tweak[32];
+    uint8_t point[65];
+
+    bbn_tagged_hash_init(&hash_context, BBN_TAG_TAPTWEAK);
+    crypto_hash_update(&hash_context.header, NUMS_POINT + 1, 32);
+    crypto_hash_update(&hash_context.header, root, 32);
+    crypto_hash_digest(&hash_context.header, tweak, 32);
+    if (memcmp(tweak, SECP256K1_N, 32) >= 0) {
+        return false;
+    }
+
+    memcpy(point, SECP256K1_G, sizeof(point));
+    if (cx_ecfp_scalar_mult_no_throw(CX_CURVE_256K1, point, tweak, sizeof(tweak)) != CX_OK ||
+        cx_ecfp_add_point_no_throw(CX_CURVE_256K1, point, point, NUMS_POINT) != CX_OK) {
+        return false;
+    }
+    memcpy(out, point + 1, 32);
+    return true;
+}
+
+const uint8_t *bbn_taptree_output_key_view(bbn_tree_t tree) {
+    if (tree >= BBN_TREE_COUNT) {
+        return NULL;
+    }
+    if (!(g_bbn_taptree.key_valid & (1 << tree))) {
+        const uint8_t *root = bbn_taptree_root_view(tree);
+        if (root == NULL) {
+            return NULL;
+        }
+        BBN_TRACE_BEGIN(BBN_TRACE_TWEAK);
+        if (!bbn_taptree_tweak_nums(root, g_bbn_taptree.output_key[tree])) {
+            PRINTF("Failed to tweak public key\n");
+            BBN_TRACE_FAIL(BBN_TRACE_TWEAK);
+            return NULL;
+        }
+        BBN_TRACE_END(BBN_TRACE_TWEAK);
+        g_bbn_taptree.key_valid |= 1 << tree;
+    }
+    return g_bbn_taptree.output_key[tree];
+}
+
+bool bbn_taptree_output_key(bbn_tree_t tree, uint8_t out[static 32]) {
+    const uint8_t *key = bbn_taptree_output_key_view(tree);
+    if (key == NULL) {
+        return false;
+    }
+    memcpy(out, key, 32);
+    return true;
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifndef BBN_TAPTREE_H
+#define BBN_TAPTREE_H
+
+typedef enum {
+    BBN_LEAF_SLASHING = 0,
+    BBN_LEAF_UNBONDING,
+    BBN_LEAF_TIMELOCK,
+    BBN_LEAF_COUNT
+} bbn_leaf_t;
+
+typedef enum {
+    BBN_TREE_STAKING = 0,  // slashing, (unbonding, timelock): staking output
+    BBN_TREE_UNBONDING,    // slashing, timelock: unbonding output
+    BBN_TREE_TIMELOCK,     // timelock only: change output of the slashing transactions
+    BBN_TREE_COUNT
+} bbn_tree_t;
+
+/**
+ * Babylon taproot trees built from g_bbn_data. Every hash and tweaked key is computed the first
+ * time it is needed, then reused until the parameters or the staker key change.
+ */
+typedef struct {
+    uint8_t leaf_valid;  // bitmask over bbn_leaf_t
+    uint8_t root_valid;  // bitmask over bbn_tree_t
+    uint8_t key_valid;   // bitmask over bbn_tree_t
+    uint8_t branch_valid;
+    uint8_t leafhash[BBN_LEAF_COUNT][32];
+    uint8_t branch_hash[32];  // unbonding and timelock leaves, the right branch of the staking tree
+    uint8_t root[BBN_TREE_TIMELOCK][32];  // the timelock tree, last, has its leaf hash as root
+    uint8_t output_key[BBN_TREE_COUNT][32];  // x-only NUMS key tweaked with the root
+} bbn_taptree_t;
+
+void bbn_taptree_invalidate(void);
+bool bbn_taptree_leafhash(bbn_leaf_t leaf, uint8_t out[static 32]);
+bool bbn_taptree_root(bbn_tree_t tree, uint8_t out[static 32]);
+bool bbn_taptree_output_key(bbn_tree_t tree, uint8_t out[static 32]);
+// The memoized output key itself, valid until the next bbn_taptree_invalidate; NULL on failure
+const uint8_t *bbn_taptree_output_key_view(bbn_tree_t tree);
+
+#endif  // BBN_TAPTREE_H
@@ -1,5 +1,6 @@
 #include <stdbool.h>
 #include <stdint.h>
+#include <stddef.h>
 #include <string.h>
 #include "../bitcoin_app_base/src/common/psbt.h"
 #include "../bitcoin_app_base/src/common/bitvector.h"
@@ -8,218 +9,300 @@
 #include "bbn_def.h"
 #include "bbn_data.h"
 #include "bbn_tlv.h"
+#include "bbn_taptree.h"
+#include "bbn_session.h"
+#include "bbn_keycache.h"
+#include "bbn_script.h"
 #include "display.h"
 
-bool parse_tlv_data(const uint8_t *data, uint32_t data_len) {
-    uint32_t offset = 0;
+// How the value of a tag is stored in g_bbn_data
+typedef enum {
+    BBN_TLV_U8 = 0,  // a single byte
+    BBN_TLV_U64,     // a big-endian uint64_t
+    BBN_TLV_BYTES,   // a byte array, whole
+    BBN_TLV_SCRIPT,  // the burn address script, with its length in burn_address_len
+    BBN_TLV_KEYS,    // a list of 32-byte keys, in a slice of the pool
+    BBN_TLV_MESSAGE, // the message, hashed whole, with its start in a slice of the pool
+    BBN_TLV_PATH,    // a BIP32 path of big-endian uint32_t, in derive_path
+} bbn_tlv_kind_t;
 
-    bbn_data_reset();
+/**
+ * One tag of the TLV data. A value is accepted if its length is in [min_len, max_len] and a
+ * multiple of elem_len; it is stored at the given offset of g_bbn_data, as its kind says.
+ */
+struct bbn_tlv_schema_s {
+    uint8_t tag;
+    uint8_t field;  // bbn_field_t
+    uint8_t kind;   // bbn_tlv_kind_t
+    uint8_t elem_len;
+    uint16_t min_len;
+    uint16_t max_len;
+    uint16_t offset;
+};
 
-    PRINTF("=== TLV Data Parsing ===\n");
+#define BBN_TLV_FIELD(name) offsetof(bbn_data_t, name)
 
-    while (offset < data_len) {
-        if (offset + 1 >= data_len) {
-            PRINTF("Error: Not enough data for TAG\n");
-            return false;
-        }
+static const bbn_tlv_schema_t g_tlv_schema[] = {
+    {TAG_ACTION_TYPE, BBN_FIELD_ACTION_TYPE, BBN_TLV_U8, 1, 1, 1, BBN_TLV_FIELD(action_type)},
+    {TAG_FP_COUNT, BBN_FIELD_FP_COUNT, BBN_TLV_U8, 1, 1, 1, BBN_TLV_FIELD(fp_count)},
+    {TAG_FP_LIST,
+     BBN_FIELD_FP_LIST,
+     BBN_TLV_KEYS,
+     32,
+     32,
+     MAX_FP_COUNT * 32,
+     BBN_TLV_FIELD(fp_list)},
+    {TAG_COV_KEY_COUNT, BBN_FIELD_COV_KEY_COUNT, BBN_TLV_U8, 1, 1, 1, BBN_TLV_FIELD(cov_key_count)},
+    {TAG_COV_KEY_LIST,
+     BBN_FIELD_COV_KEY_LIST,
+     BBN_TLV_KEYS,
+     32,
+     32,
+     MAX_COV_KEY_COUNT * 32,
+     BBN_TLV_FIELD(cov_key_list)},
+    {TAG_STAKER_PK, BBN_FIELD_STAKER_PK, BBN_TLV_BYTES, 1, 32, 32, BBN_TLV_FIELD(staker_pk)},
+    {TAG_COV_QUORUM, BBN_FIELD_COV_QUORUM, BBN_TLV_U8, 1, 1, 1, BBN_TLV_FIELD(cov_quorum)},
+    {TAG_FP_QUORUM, BBN_FIELD_FP_QUORUM, BBN_TLV_U8, 1, 1, 1, BBN_TLV_FIELD(fp_quorum)},
+    {TAG_TIMELOCK, BBN_FIELD_TIMELOCK, BBN_TLV_U64, 1, 8, 8, BBN_TLV_FIELD(timelock)},
+    {TAG_UNBONDING_TIMELOCK,
+     BBN_FIELD_UNBONDING_TIMELOCK,
+     BBN_TLV_U64,
+     1,
+     8,
+     8,
+     BBN_TLV_FIELD(unbonding_timelock)},
+    {TAG_SLASHING_FEE_LIMIT,
+     BBN_FIELD_SLASHING_FEE_LIMIT,
+     BBN_TLV_U64,
+     1,
+     8,
+     8,
+     BBN_TLV_FIELD(slashing_fee_limit)},
+    {TAG_UNBONDING_FEE_LIMIT,
+     BBN_FIELD_UNBONDING_FEE_LIMIT,
+     BBN_TLV_U64,
+     1,
+     8,
+     8,
+     BBN_TLV_FIELD(unbonding_fee_limit)},
+    {TAG_MESSAGE,
+     BBN_FIELD_MESSAGE,
+     BBN_TLV_MESSAGE,
+     1,
+     0,
+     BBN_MAX_TLV_DATA_LEN,
+     BBN_TLV_FIELD(message)},
+    {TAG_TXID, BBN_FIELD_TXID, BBN_TLV_BYTES, 1, 32, 32, BBN_TLV_FIELD(txid)},
+    {TAG_BURN_ADDRESS,
+     BBN_FIELD_BURN_ADDRESS,
+     BBN_TLV_SCRIPT,
+     1,
+     1,
+     32,
+     BBN_TLV_FIELD(burn_address)},
+    {TAG_MESSAGE_KEY, BBN_FIELD_MESSAGE_KEY, BBN_TLV_BYTES, 1, 32, 32, BBN_TLV_FIELD(message_key)},
+    {TAG_BIP32_PATH,
+     BBN_FIELD_BIP32_PATH,
+     BBN_TLV_PATH,
+     4,
+     0,
+     sizeof(((bbn_data_t *) 0)->derive_path),
+     BBN_TLV_FIELD(derive_path)},
+};
 
-        uint8_t tag = data[offset++];
-        uint16_t length = 0;
-        if (offset >= data_len) {
-            PRINTF("Error: Not enough data for LENGTH\n");
-            return false;
+static const bbn_tlv_schema_t *bbn_tlv_schema(uint8_t tag) {
+    for (size_t i = 0; i < sizeof(g_tlv_schema) / sizeof(g_tlv_schema[0]); i++) {
+        if (g_tlv_schema[i].tag == tag) {
+            return &g_tlv_schema[i];
         }
+    }
+    return NULL;
+}
 
-        if (offset + 2 > data_len) {
-            PRINTF("Error: Not enough data for 2-byte LENGTH\n");
-            return false;
-        }
-        length = (data[offset] << 8) | data[offset + 1];
-        offset += 2;
-
-        if (offset + length > data_len) {
-            PRINTF("Error: Not enough data for VALUE (need %d bytes, have %d)\n",
-                   length,
-                   (int) (data_len - offset));
-            return false;
-        }
+// Checks the value announced for the current tag, and selects where its bytes go.
+static bool bbn_tlv_begin_value(bbn_tlv_parser_t *parser) {
+    uint16_t length = parser->length;
+    const bbn_tlv_schema_t *schema = bbn_tlv_schema(parser->tag);
 
-        const uint8_t *value = &data[offset];
+    PRINTF("TAG: 0x%02x, LEN: %d\n", parser->tag, length);
 
-        PRINTF("TAG: 0x%02x, LEN: %d, VALUE: ", tag, length);
-        PRINTF_BUF(value, length);
+    if (schema == NULL) {
+        PRINTF("  -> Unknown TAG: 0x%02x\n", parser->tag);
+        return false;
+    }
+    if (g_bbn_data.fields & BBN_FIELD(schema->field)) {
+        PRINTF("  -> Duplicate TAG: 0x%02x\n", parser->tag);
+        return false;
+    }
+    if (length < schema->min_len || length > schema->max_len || length % schema->elem_len != 0) {
+        PRINTF("  -> Invalid length for TAG 0x%02x\n", parser->tag);
+        return false;
+    }
 
-        // 根据TAG类型解析具体内容并存储到全局结构体
-        switch (tag) {
-            case TAG_ACTION_TYPE:
-                if (length >= 1 && value != NULL) {
-                    uint8_t action = value[0];
-                    g_bbn_data.has_action_type = true;
-                    g_bbn_data.action_type = action;
-                } else {
-                    PRINTF("  -> Invalid Action Type length or NULL value\n");
-                    return false;
-                }
-                break;
-            case TAG_FP_COUNT:
-                if (length == 1) {
-                    g_bbn_data.has_fp_count = true;
-                    g_bbn_data.fp_count = value[0];
-                } else {
-                    PRINTF("  -> Invalid FP Count length\n");
-                    return false;
-                }
-                break;
-            case TAG_FP_LIST:
-                PRINTF("  -> Finality Provider List (%d pubkeys):\n", length / 32);
-                if (length / 32 <= MAX_FP_COUNT) {
-                    g_bbn_data.has_fp_list = true;
-                    for (int j = 0; j < length / 32; j++) {
-                        memcpy(g_bbn_data.fp_list[j], value + j * 32, 32);
-                    }
-                } else {
-                    PRINTF("  -> Too many FP keys (max %d)\n", MAX_FP_COUNT);
-                    return false;
-                }
-                break;
+    uint8_t *field = (uint8_t *) &g_bbn_data + schema->offset;
+    parser->schema = schema;
+    parser->dst = parser->scratch;
+    parser->dst_len = length;
+    parser->hash_value = false;
 
-            case TAG_COV_KEY_COUNT:
-                if (length == 1) {
-                    g_bbn_data.has_cov_key_count = true;
-                    g_bbn_data.cov_key_count = value[0];
-                } else {
-                    return false;
-                }
-                break;
+    switch (schema->kind) {
+        case BBN_TLV_BYTES:
+        case BBN_TLV_SCRIPT:
+            parser->dst = field;
+            break;
+        case BBN_TLV_KEYS:
+            parser->dst = bbn_data_pool_alloc((bbn_data_slice_t *) field, length);
+            break;
+        case BBN_TLV_MESSAGE:
+            // only the start of a long message is kept, for the review
+            parser->dst_len = length < MAX_MESSAGE_LEN ? length : MAX_MESSAGE_LEN;
+            parser->dst = bbn_data_pool_alloc((bbn_data_slice_t *) field, parser->dst_len);
+            parser->hash_value = true;
+            bbn_bip322_message_hash_init(&parser->value_hash);
+            break;
+        default:
+            // the scalars and the path are decoded from the scratch area once complete
+            break;
+    }
+    if (parser->dst == NULL) {
+        PRINTF("  -> No room left for the value\n");
+        return false;
+    }
+    return true;
+}
 
-            case TAG_COV_KEY_LIST:
-                if (length / 32 <= MAX_COV_KEY_COUNT) {
-                    g_bbn_data.has_cov_key_list = true;
-                    for (int j = 0; j < length / 32; j++) {
-                        memcpy(g_bbn_data.cov_key_list[j], value + j * 32, 32);
-                    }
-                } else {
-                    PRINTF("  -> Too many COV keys (max %d)\n", MAX_COV_KEY_COUNT);
-                    return false;
-                }
-                break;
-            case TAG_STAKER_PK:
-                if (length == 32) {
-                    g_bbn_data.has_staker_pk = true;
-                    memcpy(g_bbn_data.staker_pk, value, 32);
-                } else {
-                    PRINTF("  -> Invalid Staker PK length\n");
-                    return false;
-                }
-                break;
-            case TAG_COV_QUORUM:
-                if (length == 1) {
-                    g_bbn_data.has_cov_quorum = true;
-                    g_bbn_data.cov_quorum = value[0];
-                } else {
-                    PRINTF("  -> Invalid Cov Quorum length\n");
-                    return false;
-                }
-                break;
-            case TAG_FP_QUORUM:
-                if (length == 1) {
-                    g_bbn_data.has_fp_quorum = true;
-                    g_bbn_data.fp_quorum = value[0];
-                } else {
-                    PRINTF("  -> Invalid FP Quorum length\n");
-                    return false;
-                }
-                break;
-            case TAG_TIMELOCK:
-                if (length == 8) {
-                    uint64_t timelock = read_u64_be(value, 0);
-                    g_bbn_data.has_timelock = true;
-                    g_bbn_data.timelock = timelock;
-                } else {
-                    PRINTF("  -> Invalid Timelock length\n");
-                    return false;
-                }
-                break;
+// Decodes the completed value into g_bbn_data, if it was not received there already.
+static void bbn_tlv_end_value(bbn_tlv_parser_t *parser) {
+    const bbn_tlv_schema_t *schema = parser->schema;
+    const uint8_t *value = parser->scratch;
+    uint8_t *field = (uint8_t *) &g_bbn_data + schema->offset;
 
-            case TAG_SLASHING_FEE_LIMIT:
-                if (length == 8) {
-                    uint64_t limit = read_u64_be(value, 0);
-                    g_bbn_data.has_slashing_fee_limit = true;
-                    g_bbn_data.slashing_fee_limit = limit;
-                } else {
-                    PRINTF("  -> Invalid Slashing Fee Limit length\n");
-                    return false;
-                }
-                break;
-            case TAG_UNBONDING_FEE_LIMIT:
-                if (length == 8) {
-                    uint64_t limit = read_u64_be(value, 0);
-                    g_bbn_data.has_unbonding_fee_limit = true;
-                    g_bbn_data.unbonding_fee_limit = limit;
-                } else {
-                    PRINTF("  -> Invalid Unbonding Fee Limit length\n");
-                    return false;
-                }
-                break;
-            case TAG_MESSAGE:
-                if (length <= sizeof(g_bbn_data.message)) {
-                    memcpy(g_bbn_data.message, value, length);
-                    g_bbn_data.has_message = true;
-                    g_bbn_data.message_len = length;
-                } else {
-                    PRINTF("  -> Message length exceeds maximum size\n");
-                    return false;
-                }
+    PRINTF("  -> VALUE: ");
+    PRINTF_BUF(parser->dst, parser->dst_len);
+
+    switch (schema->kind) {
+        case BBN_TLV_U8:
+            *field = value[0];
+            break;
+        case BBN_TLV_U64:
+            *(uint64_t *) field = read_u64_be(value, 0);
+            break;
+        case BBN_TLV_SCRIPT:
+            g_bbn_data.burn_address_len = parser->length;
+            break;
+        case BBN_TLV_MESSAGE:
+            g_bbn_data.message_len = parser->length;
+            crypto_hash_digest(&parser->value_hash.header, g_bbn_data.message_hash, 32);
+            break;
+        case BBN_TLV_PATH:
+            for (uint32_t i = 0; i < parser->length / 4; i++) {
+                g_bbn_data.derive_path[i] = read_u32_be(value, i * 4);
+            }
+            g_bbn_data.derive_path_len = parser->length / 4;
+            break;
+        default:
+            break;
+    }
+    g_bbn_data.fields |= BBN_FIELD(schema->field);
+}
+
+void bbn_tlv_parser_init(bbn_tlv_parser_t *parser, size_t data_len) {
+    memset(parser, 0, sizeof(bbn_tlv_parser_t));
+    parser->state = BBN_TLV_STATE_TAG;
+
+    bbn_data_begin(data_len);
+
+    PRINTF("=== TLV Data Parsing ===\n");
+}
+
+bool bbn_tlv_parser_feed(bbn_tlv_parser_t *parser, const uint8_t *data, uint32_t data_len) {
+    uint32_t offset = 0;
+
+    while (offset < data_len) {
+        switch (parser->state) {
+            case BBN_TLV_STATE_TAG:
+                parser->tag = data[offset++];
+                parser->state = BBN_TLV_STATE_LEN_HI;
                 break;
-            case TAG_TXID:
-                if (length == 32) {
-                    memcpy(g_bbn_data.txid, value, 32);
-                    g_bbn_data.has_txid = true;
-                } else {
-                    PRINTF("  -> Invalid Transaction ID length\n");
-                    return false;
-                }
+            case BBN_TLV_STATE_LEN_HI:
+                parser->length = data[offset++] << 8;
+                parser->state = BBN_TLV_STATE_LEN_LO;
                 break;
-            case TAG_BURN_ADDRESS:
-                if (length >= 1 && length <= 32) {
-                    memcpy(g_bbn_data.burn_address, value, length);
-                    g_bbn_data.has_burn_address = true;
-                    g_bbn_data.burn_address_len = length;
-                } else {
-                    PRINTF("  -> Invalid Burning Address length\n");
+            case BBN_TLV_STATE_LEN_LO:
+                parser->length |= data[offset++];
+                parser->received = 0;
+                if (!bbn_tlv_begin_value(parser)) {
                     return false;
                 }
+                parser->state = BBN_TLV_STATE_VALUE;
                 break;
-            case TAG_MESSAGE_KEY:
-                if (length == 32) {
-                    memcpy(g_bbn_data.message_key, value, 32);
-                    g_bbn_data.has_message_key = true;
-                } else {
-                    PRINTF("  -> Invalid Message Key length\n");
-                    return false;
+            case BBN_TLV_STATE_VALUE: {
+                uint32_t n = parser->length - parser->received;
+                if (n > data_len - offset) {
+                    n = data_len - offset;
                 }
-                break;
-            case TAG_BIP32_PATH:
-                if (length <= sizeof(g_bbn_data.derive_path) && length % 4 == 0) {
-                    for (uint32_t i = 0; i < length / 4; i++) {
-                        g_bbn_data.derive_path[i] = read_u32_be(value, i * 4);
+                // only the first dst_len bytes of the value are kept
+                if (parser->received < parser->dst_len) {
+                    uint32_t keep = parser->dst_len - parser->received;
+                    if (keep > n) {
+                        keep = n;
                     }
-                    g_bbn_data.derive_path_len = length / 4;
-                } else {
-                    PRINTF("  -> Invalid BIP32 Path length\n");
-                    return false;
+                    memcpy(parser->dst + parser->received, data + offset, keep);
                 }
+                if (parser->hash_value) {
+                    crypto_hash_update(&parser->value_hash.header, data + offset, n);
+                }
+                parser->received += n;
+                offset += n;
                 break;
+            }
             default:
-                PRINTF("  -> Unknown TAG: 0x%02x\n", tag);
                 return false;
         }
 
-        offset += length;
+        if (parser->state == BBN_TLV_STATE_VALUE && parser->received == parser->length) {
+            bbn_tlv_end_value(parser);
+            parser->state = BBN_TLV_STATE_TAG;
+        }
+    }
+    return true;
+}
+
+bool bbn_tlv_parser_finish(const bbn_tlv_parser_t *parser) {
+    if (parser->state != BBN_TLV_STATE_TAG) {
+        PRINTF("Error: TLV data ends in the middle of an element (state %d)\n", parser->state);
+        return false;
+    }
+    // all the fields of the action are known once the data is complete
+    return bbn_data_check_required();
+}
+
+bool parse_tlv_data(const uint8_t *data, uint32_t data_len) {
+    bbn_tlv_parser_t parser;
+
+    bbn_tlv_parser_init(&parser, data_len);
+    if (!bbn_tlv_parser_feed(&parser, data, data_len) || !bbn_tlv_parser_finish(&parser)) {
+        // no partly parsed data is left behind
+        bbn_data_reset();
+        return false;
     }
     return true;
 }
 
 void bbn_data_reset(void) {
     memset(&g_bbn_data, 0, sizeof(bbn_data_t));
-}
\ No newline at end of file
+    bbn_data_set_pool(NULL, 0);
+    bbn_taptree_invalidate();
+    bbn_session_clear_current();
+    // a new parameter upload starts a new session
+    bbn_keycache_clear();
+}
+
+/**
+ * Starts a new parameter set, of data_len bytes of TLV data: its values are parsed into the
+ * session cache, where they stay once it is stored.
+ */
+void bbn_data_begin(size_t data_len) {
+    bbn_data_reset();
+    bbn_session_reserve_params(data_len);
+}
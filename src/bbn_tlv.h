@@ -1,7 +1,51 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "lib_standard_app/crypto_helpers.h"
+
 #ifndef BBN_TLV_H
 #define BBN_TLV_H
 
+#define BBN_TLV_SCRATCH_SIZE 20  // large enough for the longest scalar value (BIP32 path)
+
+typedef enum {
+    BBN_TLV_STATE_TAG = 0,
+    BBN_TLV_STATE_LEN_HI,
+    BBN_TLV_STATE_LEN_LO,
+    BBN_TLV_STATE_VALUE,
+} bbn_tlv_state_t;
+
+typedef struct bbn_tlv_schema_s bbn_tlv_schema_t;
+
+/**
+ * Incremental TLV parser state. The TLV stream may be split at any byte boundary, so tag, length
+ * and value bytes are carried over from one chunk to the next. Values are written straight into
+ * g_bbn_data when they have a buffer there, otherwise into the small scratch area and decoded
+ * once complete. The message is also hashed as it streams in, so it does not need to be kept.
+ * How each tag is checked and stored is described by a constant schema, in bbn_tlv.c.
+ */
+typedef struct {
+    uint8_t state;
+    uint8_t tag;
+    uint16_t length;                 // length of the current value
+    uint16_t received;               // value bytes received so far
+    const bbn_tlv_schema_t *schema;  // how the current value is checked and stored
+    uint8_t *dst;                    // where the value bytes are stored
+    uint16_t dst_len;                // number of value bytes kept in dst; the rest is skipped
+    uint8_t scratch[BBN_TLV_SCRATCH_SIZE];
+    bool hash_value;          // whether the value bytes go through value_hash
+    cx_sha256_t value_hash;
+} bbn_tlv_parser_t;
+
 void bbn_data_reset(void);
+void bbn_data_begin(size_t data_len);
 bool parse_tlv_data(const uint8_t *data, uint32_t data_len);
 
-#endif  // BBN_TLV_H
\ No newline at end of file
+void bbn_tlv_parser_init(bbn_tlv_parser_t *parser, size_t data_len);
+bool bbn_tlv_parser_feed(bbn_tlv_parser_t *parser, const uint8_t *data, uint32_t data_len);
+bool bbn_tlv_parser_finish(const bbn_tlv_parser_t *parser);
+
+#endif  // BBN_TLV_H
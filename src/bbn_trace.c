@@ -0,0 +1,69 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include "bbn_trace.h"
+
+#ifdef HAVE_BBN_TRACE
+
+#ifndef BBN_TRACE_CLOCK
+#include "os_io_seproxyhal.h"
+/**
+ * Apps cannot read a cycle counter on the secure element. The SDK counts milliseconds instead, on
+ * each SEPROXYHAL ticker event (every 100 ms), which it handles while it exchanges APDUs or runs
+ * the UI: a phase of pure computation shows no ticks, but the waits for the host and for the user
+ * are measured. A build can give a finer clock with BBN_TRACE_CLOCK.
+ */
+#define BBN_TRACE_CLOCK() ((uint32_t) G_io_app.ms)
+#else
+uint32_t BBN_TRACE_CLOCK(void);
+#endif
+
+/**
+ * The most recent BBN_TRACE_SIZE events. The sequence number keeps counting when older entries
+ * are overwritten, so that a gap in a dump shows that events were lost.
+ */
+static struct {
+    bbn_trace_entry_t entries[BBN_TRACE_SIZE];
+    uint16_t next_seq;
+} g_bbn_trace;
+
+void bbn_trace_record(bbn_trace_phase_t phase, bbn_trace_event_t event) {
+    bbn_trace_entry_t *entry = &g_bbn_trace.entries[g_bbn_trace.next_seq % BBN_TRACE_SIZE];
+
+    entry->ticks = BBN_TRACE_CLOCK();
+    entry->seq = g_bbn_trace.next_seq++;
+    entry->phase = phase;
+    entry->event = event;
+}
+
+/**
+ * Writes the entries still in the ring buffer, oldest first, and returns the number of bytes
+ * written: a count (1 byte), then BBN_TRACE_ENTRY_LEN bytes per entry.
+ */
+size_t bbn_trace_dump(uint8_t *out, size_t out_len) {
+    uint16_t count = g_bbn_trace.next_seq < BBN_TRACE_SIZE ? g_bbn_trace.next_seq : BBN_TRACE_SIZE;
+    if (out_len < 1 + (size_t) count * BBN_TRACE_ENTRY_LEN) {
+        return 0;
+    }
+
+    size_t len = 0;
+    out[len++] = (uint8_t) count;
+    for (uint16_t seq = g_bbn_trace.next_seq - count; seq != g_bbn_trace.next_seq; seq++) {
+        const bbn_trace_entry_t *entry = &g_bbn_trace.entries[seq % BBN_TRACE_SIZE];
+        out[len++] = entry->phase;
+        out[len++] = entry->event;
+        out[len++] = entry->seq >> 8;
+        out[len++] = entry->seq & 0xff;
+        out[len++] = entry->ticks >> 24;
+        out[len++] = (entry->ticks >> 16) & 0xff;
+        out[len++] = (entry->ticks >> 8) & 0xff;
+        out[len++] = entry->ticks & 0xff;
+    }
+    return len;
+}
+
+void bbn_trace_reset(void) {
+    memset(&g_bbn_trace, 0, sizeof(g_bbn_trace));
+}
+
+#endif  // HAVE_BBN_TRACE
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#ifndef BBN_TRACE_H
+#define BBN_TRACE_H
+
+// Phases of the signing hot path, as recorded in the trace
+typedef enum {
+    BBN_TRACE_TLV_PARSE = 0,     // INS_CUSTOM_TLV upload: leaves fetched, verified and parsed
+    BBN_TRACE_VALIDATE,          // validate_and_display_transaction, UI included
+    BBN_TRACE_SIGN_INPUTS,       // sign_custom_inputs
+    BBN_TRACE_KEY_DERIVATION,    // BIP-32 derivation of the staker key
+    BBN_TRACE_LEAF_HASH,         // TapLeaf hash of one Babylon script
+    BBN_TRACE_TWEAK,             // taproot tweak of an output key or of a signing key
+    BBN_TRACE_SIGHASH,           // sighash of one input
+    BBN_TRACE_SCHNORR_SIGN,      // BIP-340 signature of one input
+    BBN_TRACE_YIELD,             // signature sent to the host
+    BBN_TRACE_PHASE_COUNT
+} bbn_trace_phase_t;
+
+// A phase that fails is closed with BBN_TRACE_FAIL_EVENT instead of BBN_TRACE_END_EVENT
+typedef enum {
+    BBN_TRACE_BEGIN_EVENT = 0,
+    BBN_TRACE_END_EVENT = 1,
+    BBN_TRACE_FAIL_EVENT = 2
+} bbn_trace_event_t;
+
+// Entries kept in the ring buffer; a dump of all of them fits in one APDU response
+#define BBN_TRACE_SIZE 30
+
+// Size of one entry in a dump: phase (1), event (1), sequence number (2), ticks (4), big-endian
+#define BBN_TRACE_ENTRY_LEN 8
+
+typedef struct {
+    uint32_t ticks;
+    uint16_t seq;
+    uint8_t phase;
+    uint8_t event;
+} bbn_trace_entry_t;
+
+#ifdef HAVE_BBN_TRACE
+
+void bbn_trace_record(bbn_trace_phase_t phase, bbn_trace_event_t event);
+size_t bbn_trace_dump(uint8_t *out, size_t out_len);
+void bbn_trace_reset(void);
+
+#define BBN_TRACE_BEGIN(phase) bbn_trace_record(phase, BBN_TRACE_BEGIN_EVENT)
+#define BBN_TRACE_END(phase)   bbn_trace_record(phase, BBN_TRACE_END_EVENT)
+#define BBN_TRACE_FAIL(phase)  bbn_trace_record(phase, BBN_TRACE_FAIL_EVENT)
+// Ends a phase with the outcome of its work
+#define BBN_TRACE_CLOSE(phase, success) \
+    bbn_trace_record(phase, (success) ? BBN_TRACE_END_EVENT : BBN_TRACE_FAIL_EVENT)
+
+#else
+
+#define BBN_TRACE_BEGIN(phase) \
+    do {                       \
+    } while (0)
+#define BBN_TRACE_END(phase) \
+    do {                     \
+    } while (0)
+#define BBN_TRACE_FAIL(phase) \
+    do {                      \
+    } while (0)
+#define BBN_TRACE_CLOSE(phase, success) \
+    do {                                \
+    } while (0)
+
+#endif  // HAVE_BBN_TRACE
+
+#endif  // BBN_TRACE_H
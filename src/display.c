@@ -1,6 +1,7 @@
 #include "../bitcoin_app_base/src/ui/display.h"
 #include "../bitcoin_app_base/src/ui/menu.h"
 #include "../bitcoin_app_base/src/common/psbt.h"
+#include "../bitcoin_app_base/src/common/read.h"
 #include "../bitcoin_app_base/src/common/bitvector.h"
 #include "../bitcoin_app_base/src/common/segwit_addr.h"
 #include "../bitcoin_app_base/src/handler/sign_psbt.h"
@@ -10,6 +11,7 @@
 #include "nbgl_use_case.h"
 #include "bbn_def.h"
 #include "bbn_data.h"
+#include "bbn_psbt.h"
 #include "display.h"
 
 #define MAX_N_PAIRS 4
@@ -48,45 +50,78 @@ static void status_operation_callback(bool confirm) {
     }
 }
 
+// Pairs of the key review kept formatted at once, more than a page of keys shows
+#define BBN_KEY_REVIEW_SLOTS 6
+
+// The pairs of one page take distinct slots only if a page has no more pairs than there are slots
+_Static_assert(NB_MAX_DISPLAYED_PAIRS_IN_REVIEW <= BBN_KEY_REVIEW_SLOTS,
+               "a review page shows more keys than BBN_KEY_REVIEW_SLOTS");
+
+/**
+ * State of the public key review. The pairs are formatted by NBGL's callback only when their page
+ * is about to be shown, in one of a few slots reused in turn.
+ */
+static struct {
+    const uint8_t *pubkeys;  // 32 bytes each
+    bool has_quorum;         // the first pair is the quorum, then come the keys
+    char quorum_value[4];
+    char hex[BBN_KEY_REVIEW_SLOTS][65];
+    char label[BBN_KEY_REVIEW_SLOTS][8];
+    nbgl_layoutTagValue_t pair[BBN_KEY_REVIEW_SLOTS];
+} g_key_review;
+
+static void bbn_hex_encode(const uint8_t *in, size_t in_len, char *out) {
+    static const char hex_digits[] = "0123456789ABCDEF";
+
+    for (size_t i = 0; i < in_len; i++) {
+        out[2 * i] = hex_digits[in[i] >> 4];
+        out[2 * i + 1] = hex_digits[in[i] & 0x0f];
+    }
+    out[2 * in_len] = '\0';
+}
+
+static nbgl_layoutTagValue_t *get_key_review_pair(uint8_t index) {
+    uint8_t slot = index % BBN_KEY_REVIEW_SLOTS;
+    nbgl_layoutTagValue_t *pair = &g_key_review.pair[slot];
+
+    memset(pair, 0, sizeof(*pair));
+    if (g_key_review.has_quorum) {
+        if (index == 0) {
+            pair->item = "Covenant quorum";
+            pair->value = g_key_review.quorum_value;
+            return pair;
+        }
+        index--;
+    }
+    bbn_hex_encode(g_key_review.pubkeys + 32 * index, 32, g_key_review.hex[slot]);
+    snprintf(g_key_review.label[slot], sizeof(g_key_review.label[slot]), "Pub %u", index + 1);
+    pair->item = g_key_review.label[slot];
+    pair->value = g_key_review.hex[slot];
+    return pair;
+}
+
 bool display_public_keys(dispatcher_context_t *dc,
                          uint32_t pub_count,
-                         uint8_t pubkey[][32],
+                         const uint8_t *pubkeys,
                          uint32_t pub_type,
                          uint32_t quorum) {
-    nbgl_layoutTagValue_t pairs[16];
     nbgl_layoutTagValueList_t pairList;
 
     confirmed_status = "Action\nconfirmed";
     rejected_status = "Action rejected";
 
-    char hexbuf[BBN_MAX_FP_COUNT][65];
-    char labels[BBN_MAX_FP_COUNT][8];
-    char quorum_value[8];
-    int n_pairs = 0;
-
-    if (pub_type == BBN_DIS_PUB_COV) {
-        snprintf(quorum_value, sizeof(quorum_value), "%d", quorum);
-        pairs[n_pairs].item = "Covenant quorum";
-        pairs[n_pairs].value = quorum_value;
-        n_pairs++;
-    }
-
-    for (uint32_t i = 0; i < pub_count; i++) {
-        for (uint32_t j = 0; j < 32; j++) {  // 假设每个 pubkey 是 32 字节
-            snprintf(&hexbuf[i][j * 2], 3, "%02X", pubkey[i][j]);
-        }
-        hexbuf[i][64] = '\0';  // 确保字符串以 null 结尾
-        snprintf(labels[i], sizeof(labels[i]), "Pub %u", i + 1);
-        pairs[n_pairs] = (nbgl_layoutTagValue_t){
-            .item = labels[i],
-            .value = hexbuf[i],
-        };
-        n_pairs++;
+    memset(&g_key_review, 0, sizeof(g_key_review));
+    g_key_review.pubkeys = pubkeys;
+    g_key_review.has_quorum = pub_type == BBN_DIS_PUB_COV;
+    if (g_key_review.has_quorum) {
+        snprintf(g_key_review.quorum_value, sizeof(g_key_review.quorum_value), "%u", quorum);
     }
 
+    memset(&pairList, 0, sizeof(pairList));
     pairList.nbMaxLinesForValue = 0;
-    pairList.nbPairs = n_pairs;
-    pairList.pairs = pairs;
+    pairList.nbPairs = pub_count + (g_key_review.has_quorum ? 1 : 0);
+    pairList.pairs = NULL;
+    pairList.callback = get_key_review_pair;
     if (pub_type == BBN_DIS_PUB_COV) {
         nbgl_useCaseReviewLight(TYPE_OPERATION,
                                 &pairList,
@@ -115,6 +150,49 @@ bool display_public_keys(dispatcher_context_t *dc,
     return true;
 }
 
+bool display_covenant_committee(dispatcher_context_t *dc,
+                                const char *name,
+                                uint32_t key_count,
+                                uint32_t quorum) {
+    nbgl_layoutTagValue_t pairs[2];
+    nbgl_layoutTagValueList_t pairList;
+
+    confirmed_status = "Action\nconfirmed";
+    rejected_status = "Action rejected";
+
+    char quorum_value[16];
+    snprintf(quorum_value, sizeof(quorum_value), "%u of %u", quorum, key_count);
+    pairs[0] = (nbgl_layoutTagValue_t){
+        .item = "Covenant committee",
+        .value = name,
+    };
+    pairs[1] = (nbgl_layoutTagValue_t){
+        .item = "Covenant quorum",
+        .value = quorum_value,
+    };
+
+    memset(&pairList, 0, sizeof(pairList));
+    pairList.nbMaxLinesForValue = 0;
+    pairList.nbPairs = 2;
+    pairList.pairs = pairs;
+    nbgl_useCaseReviewLight(TYPE_OPERATION,
+                            &pairList,
+                            &ICON_APP_ACTION,
+                            "Covenant committee",
+                            NULL,
+                            "Confirm covenant\ncommittee",
+                            status_operation_callback);
+
+    // blocking call until the user approves or rejects the transaction
+    bool result = io_ui_process(dc);
+    if (!result) {
+        SEND_SW(dc, SW_DENY);
+        return false;
+    }
+
+    return true;
+}
+
 bool display_transaction(dispatcher_context_t *dc,
                          int64_t value_spent,
                          uint8_t *scriptpubkey,
@@ -185,37 +263,33 @@ bool display_transaction(dispatcher_context_t *dc,
     return true;
 }
 
-bool display_actions(dispatcher_context_t *dc, uint32_t action_type) {
-    confirmed_status = "Action\nconfirmed";
-    rejected_status = "Action rejected";
-    static char action_name[64];
-    static char action_name_approve[64];
+static const char *bbn_action_name(uint32_t action_type) {
     switch ((bbn_action_type_t) action_type) {
         case BBN_POLICY_SLASHING:
-            strncpy(action_name, BBN_POLICY_NAME_SLASHING, sizeof(action_name) - 1);
-            break;
+            return BBN_POLICY_NAME_SLASHING;
         case BBN_POLICY_SLASHING_UNBONDING:
-            strncpy(action_name, BBN_POLICY_NAME_SLASHING_UNBONDING, sizeof(action_name) - 1);
-            break;
+            return BBN_POLICY_NAME_SLASHING_UNBONDING;
         case BBN_POLICY_STAKE_TRANSFER:
-            strncpy(action_name, BBN_POLICY_NAME_STAKE_TRANSFER, sizeof(action_name) - 1);
-            break;
+            return BBN_POLICY_NAME_STAKE_TRANSFER;
         case BBN_POLICY_UNBOND:
-            strncpy(action_name, BBN_POLICY_NAME_UNBOND, sizeof(action_name) - 1);
-            break;
+            return BBN_POLICY_NAME_UNBOND;
         case BBN_POLICY_WITHDRAW:
-            strncpy(action_name, BBN_POLICY_NAME_WITHDRAW, sizeof(action_name) - 1);
-            break;
+            return BBN_POLICY_NAME_WITHDRAW;
         case BBN_POLICY_BIP322:
-            strncpy(action_name, BBN_POLICY_NAME_BIP322_MESSAGE, sizeof(action_name) - 1);
-            break;
+            return BBN_POLICY_NAME_BIP322_MESSAGE;
         case BBN_POLICY_EXPANSION:
-            strncpy(action_name, BBN_POLICY_NAME_BIP322_EXPANSION, sizeof(action_name) - 1);
-            break;
+            return BBN_POLICY_NAME_BIP322_EXPANSION;
         default:
-            strncpy(action_name, "Unknown action", sizeof(action_name) - 1);
-            break;
+            return "Unknown action";
     }
+}
+
+bool display_actions(dispatcher_context_t *dc, uint32_t action_type) {
+    confirmed_status = "Action\nconfirmed";
+    rejected_status = "Action rejected";
+    static char action_name[64];
+    static char action_name_approve[64];
+    strncpy(action_name, bbn_action_name(action_type), sizeof(action_name) - 1);
     action_name[sizeof(action_name) - 1] = '\0';
 
     // 构造 "Approve ..." 字符串
@@ -247,6 +321,47 @@ bool display_actions(dispatcher_context_t *dc, uint32_t action_type) {
     return true;
 }
 
+bool display_bundle_actions(dispatcher_context_t *dc, uint8_t action_mask) {
+    confirmed_status = "Actions\nconfirmed";
+    rejected_status = "Actions rejected";
+
+    static nbgl_layoutTagValue_t pairs[BBN_POLICY_COUNT];
+    static nbgl_layoutTagValueList_t pairList;
+    static char labels[BBN_POLICY_COUNT][16];
+    int n_pairs = 0;
+
+    for (uint32_t action_type = 0; action_type < BBN_POLICY_COUNT; action_type++) {
+        if (!(action_mask & (1 << action_type))) {
+            continue;
+        }
+        snprintf(labels[n_pairs], sizeof(labels[n_pairs]), "Transaction %d", n_pairs + 1);
+        pairs[n_pairs].item = labels[n_pairs];
+        pairs[n_pairs].value = bbn_action_name(action_type);
+        n_pairs++;
+    }
+
+    pairList.nbMaxLinesForValue = 0;
+    pairList.nbPairs = n_pairs;
+    pairList.pairs = pairs;
+    PRINTF("Reviewing bundle of %d actions\n", n_pairs);
+    nbgl_useCaseReviewLight(TYPE_OPERATION,
+                            &pairList,
+                            &ICON_APP_ACTION,
+                            "Babylon delegation",
+                            "The parameters reviewed next apply to all these transactions",
+                            "Approve delegation\ntransactions",
+                            status_operation_callback);
+
+    // blocking call until the user approves or rejects the actions
+    bool result = io_ui_process(dc);
+    if (!result) {
+        SEND_SW(dc, SW_DENY);
+        return false;
+    }
+
+    return true;
+}
+
 bool __attribute__((noinline)) display_external_outputs(
     dispatcher_context_t *dc,
     sign_psbt_state_t *st,
@@ -266,7 +381,6 @@ bool __attribute__((noinline)) display_external_outputs(
             // external output, user needs to validate
             uint8_t out_scriptPubKey[MAX_OUTPUT_SCRIPTPUBKEY_LEN];
             size_t out_scriptPubKey_len;
-            // TODO: to check why there is path not init the out amount
             uint64_t out_amount = 0;
 
             if (external_outputs_count < N_CACHED_EXTERNAL_OUTPUTS) {
@@ -281,7 +395,8 @@ bool __attribute__((noinline)) display_external_outputs(
                                                   st,
                                                   cur_output_index,
                                                   out_scriptPubKey,
-                                                  &out_scriptPubKey_len)) {
+                                                  &out_scriptPubKey_len,
+                                                  &out_amount)) {
                     SEND_SW(dc, SW_INCORRECT_DATA);
                     return false;
                 }
@@ -309,21 +424,17 @@ bool get_output_script_and_amount(dispatcher_context_t *dc,
                                   sign_psbt_state_t *st,
                                   size_t output_index,
                                   uint8_t out_scriptPubKey[static MAX_OUTPUT_SCRIPTPUBKEY_LEN],
-                                  size_t *out_scriptPubKey_len) {
-    // if (out_scriptPubKey == NULL || out_amount == NULL) {
-    if (out_scriptPubKey == NULL) {
+                                  size_t *out_scriptPubKey_len,
+                                  uint64_t *out_amount) {
+    if (out_scriptPubKey == NULL || out_amount == NULL) {
         PRINTF("get_output_script_and_amount: out_scriptPubKey or out_amount is NULL\n");
         SEND_SW(dc, SW_BAD_STATE);
         return false;
     }
 
+    // the key ordering of the map was checked once, at the beginning of sign_psbt
     merkleized_map_commitment_t map;
-
-    // TODO: This might be too slow, as it checks the integrity of the map;
-    //       Refactor so that the map key ordering is checked all at the beginning of sign_psbt.
-    int res = call_get_merkleized_map(dc, st->outputs_root, st->n_outputs, output_index, &map);
-
-    if (res < 0) {
+    if (!bbn_psbt_get_output_map(dc, st, output_index, &map)) {
         SEND_SW(dc, SW_INCORRECT_DATA);
         return false;
     }
@@ -342,6 +453,7 @@ bool get_output_script_and_amount(dispatcher_context_t *dc,
         SEND_SW(dc, SW_INCORRECT_DATA);
         return false;
     }
+    *out_amount = read_u64_le(raw_result, 0);
 
     // Read the output's scriptPubKey
     result_len = call_get_merkleized_map_value(dc,
@@ -429,6 +541,62 @@ bool display_timelock(dispatcher_context_t *dc, uint32_t time_lock) {
     return true;
 }
 
+/**
+ * Shows the timelocks of a bundle on one screen: the staking one and the unbonding one, each only
+ * if it is not 0, that is if the bundle has a transaction using it.
+ */
+bool display_bundle_timelocks(dispatcher_context_t *dc,
+                              uint32_t staking_timelock,
+                              uint32_t unbonding_timelock) {
+    nbgl_layoutTagValue_t pairs[2];
+    nbgl_layoutTagValueList_t pairList;
+    char staking_value[11];
+    char unbonding_value[11];
+    int n_pairs = 0;
+
+    confirmed_status = "Timelocks\nconfirmed";
+    rejected_status = "Timelocks rejected";
+
+    if (staking_timelock != 0) {
+        snprintf(staking_value, sizeof(staking_value), "%u", staking_timelock);
+        pairs[n_pairs++] = (nbgl_layoutTagValue_t){
+            .item = "Staking timelock",
+            .value = staking_value,
+        };
+    }
+    if (unbonding_timelock != 0) {
+        snprintf(unbonding_value, sizeof(unbonding_value), "%u", unbonding_timelock);
+        pairs[n_pairs++] = (nbgl_layoutTagValue_t){
+            .item = "Unbonding timelock",
+            .value = unbonding_value,
+        };
+    }
+    if (n_pairs == 0) {
+        return true;
+    }
+
+    pairList.nbMaxLinesForValue = 0;
+    pairList.nbPairs = n_pairs;
+    pairList.pairs = pairs;
+    PRINTF("display_bundle_timelocks: %u %u\n", staking_timelock, unbonding_timelock);
+    nbgl_useCaseReviewLight(TYPE_OPERATION,
+                            &pairList,
+                            &ICON_APP_ACTION,
+                            "Timelocks",
+                            NULL,
+                            "Confirm timelocks",
+                            status_operation_callback);
+
+    // blocking call until the user approves or rejects the transaction
+    bool result = io_ui_process(dc);
+    if (!result) {
+        SEND_SW(dc, SW_DENY);
+        return false;
+    }
+
+    return true;
+}
+
 int convert_bits(uint8_t *out,
                  size_t *outlen,
                  int outbits,
@@ -461,18 +629,36 @@ bool ui_confirm_bbn_message(dispatcher_context_t *dc) {
     static nbgl_layoutTagValue_t pairs[16];
     static nbgl_layoutTagValueList_t pairList;
     static char s_name[64];
-    static char s_value[256];
+    static char s_value[MAX_MESSAGE_LEN + 1];
+    static char s_length[16];
 
     confirmed_status = "Action\nconfirmed";
     rejected_status = "Action rejected";
 
     memset(s_name, 0, sizeof(s_name));
     memset(s_value, 0, sizeof(s_value));
-
-    g_bbn_data.message[g_bbn_data.message_len] = '\0';
-
-    snprintf(s_value, sizeof(s_value), "%s", g_bbn_data.message);
-    snprintf(s_name, sizeof(s_name), "message");
+    memset(&pairList, 0, sizeof(pairList));
+
+    if (g_bbn_data.message_len > g_bbn_data.message.len) {
+        // only the start of a long message was kept: it is reviewed by its BIP-322 hash
+        snprintf(s_name, sizeof(s_name), "Message hash");
+        bbn_hex_encode(g_bbn_data.message_hash, 32, s_value);
+        snprintf(s_length, sizeof(s_length), "%u bytes", g_bbn_data.message_len);
+        pairs[1] = (nbgl_layoutTagValue_t){
+            .item = "Message length",
+            .value = s_length,
+        };
+        pairList.nbPairs = 2;
+    } else {
+        // the message is not NUL-terminated, and may stop at the first NUL byte it contains
+        snprintf(s_value,
+                 sizeof(s_value),
+                 "%.*s",
+                 (int) g_bbn_data.message.len,
+                 (const char *) bbn_data_message());
+        snprintf(s_name, sizeof(s_name), "message");
+        pairList.nbPairs = 1;
+    }
 
     // Setup data to display
     pairs[0] = (nbgl_layoutTagValue_t){
@@ -482,7 +668,6 @@ bool ui_confirm_bbn_message(dispatcher_context_t *dc) {
 
     // Setup list
     pairList.nbMaxLinesForValue = 0;
-    pairList.nbPairs = 1;
     pairList.pairs = pairs;
     nbgl_useCaseReviewLight(TYPE_OPERATION,
                             &pairList,
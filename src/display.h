@@ -18,12 +18,19 @@ bool display_transaction(dispatcher_context_t *dc,
                          uint64_t fee);
 bool display_public_keys(dispatcher_context_t *dc,
                          uint32_t pub_count,
-                         uint8_t pubkey[][32],
+                         const uint8_t *pubkeys,
                          uint32_t pub_type,
                          uint32_t quorum);
 
+bool display_covenant_committee(dispatcher_context_t *dc,
+                                const char *name,
+                                uint32_t key_count,
+                                uint32_t quorum);
+
 bool display_actions(dispatcher_context_t *dc, uint32_t action_type);
 
+bool display_bundle_actions(dispatcher_context_t *dc, uint8_t action_mask);
+
 bool __attribute__((noinline)) display_external_outputs(
     dispatcher_context_t *dc,
     sign_psbt_state_t *st,
@@ -33,7 +40,8 @@ bool get_output_script_and_amount(dispatcher_context_t *dc,
                                   sign_psbt_state_t *st,
                                   size_t output_index,
                                   uint8_t out_scriptPubKey[static MAX_OUTPUT_SCRIPTPUBKEY_LEN],
-                                  size_t *out_scriptPubKey_len);
+                                  size_t *out_scriptPubKey_len,
+                                  uint64_t *out_amount);
 
 bool __attribute__((noinline))
 display_output(dispatcher_context_t *dc,
@@ -46,4 +54,8 @@ display_output(dispatcher_context_t *dc,
 
 bool display_timelock(dispatcher_context_t *dc, uint32_t time_lock);
 
+bool display_bundle_timelocks(dispatcher_context_t *dc,
+                              uint32_t staking_timelock,
+                              uint32_t unbonding_timelock);
+
 bool ui_confirm_bbn_message(dispatcher_context_t *dc);
\ No newline at end of file
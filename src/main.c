@@ -12,17 +12,25 @@
 #include "bbn_def.h"
 #include "bbn_pub.h"
 #include "bbn_tlv.h"
+#include "bbn_merkle.h"
+#include "bbn_session.h"
+#include "bbn_taptree.h"
+#include "bbn_keycache.h"
+#include "bbn_psbt.h"
 #include "bbn_data.h"
 #include "bbn_script.h"
 #include "bbn_script.h"
 #include "bbn_address.h"
 #include "bbn_schnorr.h"
+#include "bbn_covenant.h"
+#include "bbn_hash.h"
+#include "bbn_trace.h"
+#include "bbn_stack.h"
 #include "display.h"
 
 bool psbt_get_txid_signmessage(dispatcher_context_t *dc, sign_psbt_state_t *st, uint8_t *txid) {
     merkleized_map_commitment_t ith_map;
-    int res = call_get_merkleized_map(dc, st->inputs_root, st->n_inputs, 0, &ith_map);
-    if (res < 0) {
+    if (!bbn_psbt_get_input_map(dc, st, 0, &ith_map)) {
         SEND_SW(dc, SW_INCORRECT_DATA);
         return false;
     }
@@ -62,74 +70,327 @@ bool psbt_get_tapleaf_script(dispatcher_context_t *dc,
     return true;
 }
 
-bool custom_apdu_handler(dispatcher_context_t *dc, const command_t *cmd) {
-    uint64_t data_length;
-    uint8_t data_merkle_root[32];
-    if (cmd->cla != CLA_APP) {
+static bool consume_tlv_chunk(bbn_tlv_parser_t *parser,
+                              cx_sha256_t *hash_ctx,
+                              const uint8_t *chunk,
+                              size_t chunk_len) {
+    if (!bbn_tlv_parser_feed(parser, chunk, chunk_len)) {
         return false;
     }
-    /* Disabling SIGN_MESSAGE command */
-    if (cmd->ins == SIGN_MESSAGE) {
-        io_send_sw(SW_CLA_NOT_SUPPORTED);
-        return true;
-    }
+    crypto_hash_update(&hash_ctx->header, chunk, chunk_len);
+    return true;
+}
 
-    if (cmd->ins == INS_CUSTOM_TLV) {
-        if (!buffer_read_varint(&dc->read_buffer, &data_length) ||
-            !buffer_read_bytes(&dc->read_buffer, data_merkle_root, 32)) {
-            SEND_SW(dc, SW_WRONG_DATA_LENGTH);
+/**
+ * Receives all the leaves of the TLV merkle tree in order, without merkle proofs: the tree is
+ * rebuilt from the leaves, and only its root is compared with the one committed by the host.
+ *
+ * The parsed data must not be used unless this function returns true.
+ */
+static bool stream_tlv_leaves(dispatcher_context_t *dc,
+                              const uint8_t data_merkle_root[static 32],
+                              size_t n_chunks,
+                              size_t chunk_size,
+                              size_t data_length,
+                              bbn_tlv_parser_t *parser,
+                              cx_sha256_t *hash_ctx) {
+    bbn_merkle_stream_t tree;
+    bbn_merkle_stream_init(&tree);
+
+    size_t index = 0;
+    while (index < n_chunks) {
+        uint8_t cmd = BBN_CCMD_GET_LEAVES;
+        dc->add_to_response(&cmd, 1);
+        dc->add_to_response(data_merkle_root, 32);
+        uint8_t buf[9];
+        int index_varint_len = varint_write(buf, 0, index);
+        dc->add_to_response(buf, index_varint_len);
+        dc->finalize_response(SW_INTERRUPTED_EXECUTION);
+
+        if (dc->process_interruption(dc) < 0) {
             return false;
         }
-        size_t n_chunks = (data_length + CHUNK_SIZE - 1) / CHUNK_SIZE;
 
-        if (n_chunks > MAX_CHUNK_COUNT) {
-            SEND_SW(dc, SW_INCORRECT_DATA);
+        // the host returns as many leaves as fit in its response, with no per-leaf length
+        uint8_t n_leaves;
+        if (!buffer_read_u8(&dc->read_buffer, &n_leaves) || n_leaves == 0 ||
+            n_leaves > n_chunks - index) {
+            return false;
+        }
+        for (unsigned int i = 0; i < n_leaves; i++, index++) {
+            size_t leaf_len =
+                (index == n_chunks - 1) ? data_length - index * chunk_size : chunk_size;
+            if (!buffer_can_read(&dc->read_buffer, leaf_len)) {
+                return false;
+            }
+            const uint8_t *leaf = dc->read_buffer.ptr + dc->read_buffer.offset;
+            if (!bbn_merkle_stream_add_leaf(&tree, leaf, leaf_len) ||
+                !consume_tlv_chunk(parser, hash_ctx, leaf, leaf_len)) {
+                return false;
+            }
+            buffer_seek_cur(&dc->read_buffer, leaf_len);
+        }
+        if (buffer_can_read(&dc->read_buffer, 1)) {
             return false;
         }
+    }
 
-        uint8_t complete_data[1024];
+    uint8_t root[32];
+    if (!bbn_merkle_stream_root(&tree, root) || memcmp(root, data_merkle_root, 32) != 0) {
+        PRINTF("TLV merkle root mismatch\n");
+        return false;
+    }
+    return true;
+}
 
+/**
+ * Fails an upload. The fields parsed before the error are dropped too, so that nothing is ever
+ * validated or signed with a partly received parameter set.
+ */
+static bool reject_tlv_upload(dispatcher_context_t *dc, uint16_t sw) {
+    BBN_TRACE_FAIL(BBN_TRACE_TLV_PARSE);
+    bbn_data_reset();
+    SEND_SW(dc, sw);
+    return false;
+}
+
+static bool handle_custom_tlv(dispatcher_context_t *dc, const command_t *cmd) {
+    uint64_t data_length;
+    uint8_t data_merkle_root[32];
+    uint64_t chunk_size = CHUNK_SIZE;
+
+    if (cmd->p2 > BBN_TLV_VERSION_BULK) {
+        SEND_SW(dc, SW_WRONG_P1P2);
+        return false;
+    }
+    BBN_TRACE_BEGIN(BBN_TRACE_TLV_PARSE);
+
+    if (!buffer_read_varint(&dc->read_buffer, &data_length) ||
+        !buffer_read_bytes(&dc->read_buffer, data_merkle_root, 32)) {
+        return reject_tlv_upload(dc, SW_WRONG_DATA_LENGTH);
+    }
+
+    size_t n_chunks;
+    if (cmd->p2 != BBN_TLV_VERSION_0) {
+        if (!buffer_read_varint(&dc->read_buffer, &chunk_size)) {
+            return reject_tlv_upload(dc, SW_WRONG_DATA_LENGTH);
+        }
+        if (chunk_size == 0 || chunk_size > BBN_MAX_CHUNK_SIZE || data_length == 0 ||
+            data_length > BBN_MAX_TLV_DATA_LEN) {
+            return reject_tlv_upload(dc, SW_INCORRECT_DATA);
+        }
+        n_chunks = (data_length + chunk_size - 1) / chunk_size;
+    } else {
+        n_chunks = (data_length + CHUNK_SIZE - 1) / CHUNK_SIZE;
+        if (n_chunks > MAX_CHUNK_COUNT) {
+            return reject_tlv_upload(dc, SW_INCORRECT_DATA);
+        }
+    }
+
+    // The TLV data is parsed and hashed as each chunk arrives; no reassembly buffer is needed
+    // its values take at most as many bytes as the data, in the session cache
+    bbn_tlv_parser_t parser;
+    bbn_tlv_parser_init(&parser,
+                        data_length < BBN_DATA_POOL_SIZE ? (size_t) data_length
+                                                         : BBN_DATA_POOL_SIZE);
+
+    cx_sha256_t hash_ctx;
+    cx_sha256_init(&hash_ctx);
+
+    if (cmd->p2 == BBN_TLV_VERSION_BULK) {
+        if (!stream_tlv_leaves(dc,
+                               data_merkle_root,
+                               n_chunks,
+                               chunk_size,
+                               data_length,
+                               &parser,
+                               &hash_ctx)) {
+            return reject_tlv_upload(dc, SW_INCORRECT_DATA);
+        }
+    } else {
         size_t received_data = 0;
         for (unsigned int i = 0; i < n_chunks; i++) {
-            uint8_t chunk[CHUNK_SIZE];
+            uint8_t chunk[BBN_MAX_CHUNK_SIZE];
             int chunk_len =
-                call_get_merkle_leaf_element(dc, data_merkle_root, n_chunks, i, chunk, CHUNK_SIZE);
+                call_get_merkle_leaf_element(dc, data_merkle_root, n_chunks, i, chunk, chunk_size);
 
-            if (chunk_len < 0 || (chunk_len != CHUNK_SIZE && i != n_chunks - 1)) {
-                SEND_SW(dc, SW_INCORRECT_DATA);
-                return false;
+            if (chunk_len < 0 || (chunk_len != (int) chunk_size && i != n_chunks - 1)) {
+                return reject_tlv_upload(dc, SW_INCORRECT_DATA);
+            }
+            // the negotiated size is strict: the last leaf must carry exactly the remaining bytes
+            if (cmd->p2 == BBN_TLV_VERSION_CHUNKED && i == n_chunks - 1 &&
+                received_data + chunk_len != data_length) {
+                return reject_tlv_upload(dc, SW_INCORRECT_DATA);
             }
 
-            size_t copy_len = (received_data + chunk_len <= data_length)
+            size_t feed_len = (received_data + chunk_len <= data_length)
                                   ? chunk_len
                                   : (data_length - received_data);
-            if (copy_len + received_data > sizeof(complete_data)) {
-                SEND_SW(dc, SW_INCORRECT_DATA);
-                return false;
+            if (!consume_tlv_chunk(&parser, &hash_ctx, chunk, feed_len)) {
+                return reject_tlv_upload(dc, SW_INCORRECT_DATA);
             }
-            memcpy(complete_data + received_data, chunk, copy_len);
-            received_data += copy_len;
+            received_data += feed_len;
         }
+    }
 
-        if (!parse_tlv_data(complete_data, received_data)) {
+    if (!bbn_tlv_parser_finish(&parser)) {
+        return reject_tlv_upload(dc, SW_INCORRECT_DATA);
+    }
+
+    uint8_t final_hash[32];
+    crypto_hash_digest(&hash_ctx.header, final_hash, 32);
+    bbn_session_store_params(final_hash);
+    BBN_TRACE_END(BBN_TRACE_TLV_PARSE);
+    dc->add_to_response(final_hash, 32);
+    SEND_SW(dc, SW_OK);
+    return true;
+}
+
+static bool handle_reuse_tlv(dispatcher_context_t *dc) {
+    uint8_t tlv_hash[32];
+
+    if (!buffer_read_bytes(&dc->read_buffer, tlv_hash, 32)) {
+        SEND_SW(dc, SW_WRONG_DATA_LENGTH);
+        return false;
+    }
+    if (!bbn_session_load_params(tlv_hash)) {
+        SEND_SW(dc, SW_INCORRECT_DATA);
+        return false;
+    }
+
+    // one delegation signs several actions with the same parameters: the action can be overridden
+    uint8_t action_type;
+    if (buffer_read_u8(&dc->read_buffer, &action_type)) {
+        g_bbn_data.fields |= BBN_FIELD(BBN_FIELD_ACTION_TYPE);
+        g_bbn_data.action_type = action_type;
+        if (!bbn_data_check_required()) {
+            bbn_data_reset();
             SEND_SW(dc, SW_INCORRECT_DATA);
             return false;
         }
+    }
 
-        cx_sha256_t hash_ctx;
-        cx_sha256_init(&hash_ctx);
-        crypto_hash_update(&hash_ctx.header, complete_data, received_data);
+    dc->add_to_response(tlv_hash, 32);
+    SEND_SW(dc, SW_OK);
+    return true;
+}
+
+static bool handle_bundle_tlv(dispatcher_context_t *dc) {
+    uint8_t tlv_hash[32];
+    uint8_t action_mask;
 
-        uint8_t final_hash[32];
-        crypto_hash_digest(&hash_ctx.header, final_hash, 32);
-        dc->add_to_response(final_hash, 32);
-        SEND_SW(dc, SW_OK);
+    if (!buffer_read_bytes(&dc->read_buffer, tlv_hash, 32) ||
+        !buffer_read_u8(&dc->read_buffer, &action_mask)) {
+        SEND_SW(dc, SW_WRONG_DATA_LENGTH);
+        return false;
+    }
+    if (!bbn_session_bundle_begin(tlv_hash, action_mask)) {
+        SEND_SW(dc, SW_INCORRECT_DATA);
+        return false;
+    }
+
+    dc->add_to_response(tlv_hash, 32);
+    SEND_SW(dc, SW_OK);
+    return true;
+}
+
+#ifdef HAVE_BBN_TRACE
+static bool handle_debug_trace(dispatcher_context_t *dc, const command_t *cmd) {
+    uint8_t dump[1 + BBN_TRACE_SIZE * BBN_TRACE_ENTRY_LEN];
+    size_t dump_len = bbn_trace_dump(dump, sizeof(dump));
+
+    if (cmd->p2 & BBN_TRACE_P2_RESET) {
+        bbn_trace_reset();
+    }
+    dc->add_to_response(dump, dump_len);
+    SEND_SW(dc, SW_OK);
+    return true;
+}
+#endif
+
+#ifdef HAVE_BBN_STACK_PROFILE
+static bool handle_debug_stack(dispatcher_context_t *dc, const command_t *cmd) {
+    uint8_t report[4 + 1 + 4 * BBN_STACK_HANDLER_COUNT];
+    size_t report_len = bbn_stack_report(report, sizeof(report));
+
+    if (cmd->p2 & BBN_STACK_P2_RESET) {
+        bbn_stack_reset();
+    }
+    dc->add_to_response(report, report_len);
+    SEND_SW(dc, SW_OK);
+    return true;
+}
+#endif
+
+#ifdef HAVE_BBN_HASH_SELFTEST
+// Hashes the payload with each tag, from the midstates, and compares with the SDK initialiser
+static bool handle_debug_hash(dispatcher_context_t *dc) {
+    uint8_t digests[BBN_TAG_COUNT * 32];
+    uint8_t mismatch =
+        bbn_tagged_hash_selftest(dc->read_buffer.ptr + dc->read_buffer.offset,
+                                 dc->read_buffer.size - dc->read_buffer.offset,
+                                 digests);
+
+    dc->add_to_response(&mismatch, 1);
+    dc->add_to_response(digests, sizeof(digests));
+    SEND_SW(dc, SW_OK);
+    return true;
+}
+#endif
+
+bool custom_apdu_handler(dispatcher_context_t *dc, const command_t *cmd) {
+    if (cmd->cla != CLA_APP) {
+        return false;
+    }
+    /* Disabling SIGN_MESSAGE command */
+    if (cmd->ins == SIGN_MESSAGE) {
+        io_send_sw(SW_CLA_NOT_SUPPORTED);
         return true;
     }
 
+    if (cmd->ins == INS_CUSTOM_TLV) {
+        bool result;
+        switch (cmd->p1) {
+            case BBN_TLV_P1_UPLOAD:
+                BBN_STACK_ENTER(BBN_STACK_TLV_UPLOAD);
+                result = handle_custom_tlv(dc, cmd);
+                BBN_STACK_LEAVE(BBN_STACK_TLV_UPLOAD);
+                return result;
+            case BBN_TLV_P1_REUSE:
+                BBN_STACK_ENTER(BBN_STACK_TLV_REUSE);
+                result = handle_reuse_tlv(dc);
+                BBN_STACK_LEAVE(BBN_STACK_TLV_REUSE);
+                return result;
+            case BBN_TLV_P1_BUNDLE:
+                BBN_STACK_ENTER(BBN_STACK_TLV_BUNDLE);
+                result = handle_bundle_tlv(dc);
+                BBN_STACK_LEAVE(BBN_STACK_TLV_BUNDLE);
+                return result;
+#ifdef HAVE_BBN_TRACE
+            case BBN_TLV_P1_DEBUG_TRACE:
+                return handle_debug_trace(dc, cmd);
+#endif
+#ifdef HAVE_BBN_STACK_PROFILE
+            case BBN_TLV_P1_DEBUG_STACK:
+                return handle_debug_stack(dc, cmd);
+#endif
+#ifdef HAVE_BBN_HASH_SELFTEST
+            case BBN_TLV_P1_DEBUG_HASH:
+                return handle_debug_hash(dc);
+#endif
+            default:
+                SEND_SW(dc, SW_WRONG_P1P2);
+                return false;
+        }
+    }
+
     return false;
 }
 
+static bool validate_bbn_transaction(dispatcher_context_t *dc,
+                                     sign_psbt_state_t *st,
+                                     const uint8_t internal_outputs[64]);
+
 /**
  * @brief Validates and displays the transaction's Clear Signing UX for user confirmation.
  *
@@ -157,80 +418,20 @@ bool validate_and_display_transaction(dispatcher_context_t *dc,
                                       const uint8_t internal_inputs[64],
                                       const uint8_t internal_outputs[64]) {
     UNUSED(internal_inputs);
+    BBN_STACK_ENTER(BBN_STACK_VALIDATE);
+    BBN_TRACE_BEGIN(BBN_TRACE_VALIDATE);
+    bool result = validate_bbn_transaction(dc, st, internal_outputs);
+    BBN_TRACE_CLOSE(BBN_TRACE_VALIDATE, result);
+    BBN_STACK_LEAVE(BBN_STACK_VALIDATE);
+    return result;
+}
 
-    PRINTF("g_bbn_data.derive_path_len: %d\n", g_bbn_data.derive_path_len);
-    PRINTF("g_bbn_data.derive_path: ");
-    for (size_t i = 0; i < g_bbn_data.derive_path_len; i++) {
-        PRINTF("0x%x ", g_bbn_data.derive_path[i]);
-    }
-    PRINTF("\n");
-
-    // get staker public key
-    // use path from psbt
-    uint8_t pubkey[32];
-    if (!bbn_derive_pubkey(g_bbn_data.derive_path, g_bbn_data.derive_path_len, pubkey)) {
-        PRINTF("Failed to derive pubkey\n");
-        return false;
-    }
-    // TODO:
-    // need to compare the staker pk in taproot script if have
-    memcpy(g_bbn_data.staker_pk, pubkey, 32);
-    g_bbn_data.has_staker_pk = true;
-    PRINTF("g_bbn_data.staker_pk: ");
-    PRINTF_BUF(g_bbn_data.staker_pk, 32);
-    PRINTF("action_type: %d\n", g_bbn_data.action_type);
-
-    if (g_bbn_data.action_type == BBN_POLICY_BIP322) {
-        if (!ui_confirm_bbn_message(dc)) {
-            PRINTF("ui_confirm_bbn_message failed\n");
-            SEND_SW(dc, SW_DENY);
-            return false;
-        }
-    } else {
-        if (!display_actions(dc, g_bbn_data.action_type)) {
-            PRINTF("display_actions failed\n");
-            SEND_SW(dc, SW_DENY);
-            return false;
-        }
-    }
-
-    if (g_bbn_data.has_fp_list) {
-        if (!display_public_keys(dc, g_bbn_data.fp_count, g_bbn_data.fp_list, BBN_DIS_PUB_FP, 0)) {
-            PRINTF("display_public_keys failed\n");
-            return false;
-        }
-    }
-
-    if (g_bbn_data.has_cov_key_list) {
-        if (!display_public_keys(dc,
-                                 g_bbn_data.cov_key_count,
-                                 g_bbn_data.cov_key_list,
-                                 BBN_DIS_PUB_COV,
-                                 g_bbn_data.cov_quorum)) {
-            PRINTF("display_public_keys failed\n");
-            return false;
-        }
-    }
-    if (g_bbn_data.has_timelock) {
-        if (g_bbn_data.action_type != BBN_POLICY_SLASHING &&
-            g_bbn_data.action_type != BBN_POLICY_SLASHING_UNBONDING) {
-            if (!display_timelock(dc, (uint32_t) g_bbn_data.timelock)) {
-                PRINTF("display_timelock failed\n");
-                return false;
-            }
-        }
-    }
-
-    if (!display_external_outputs(dc, st, internal_outputs)) {
-        PRINTF("display_external_outputs fail \n");
-        return false;
-    }
-
-    if (st->warnings.high_fee && !ui_warn_high_fee(dc)) {
-        PRINTF("ui_warn_high_fee fail \n");
-        SEND_SW(dc, SW_DENY);
-        return false;
-    }
+/**
+ * Runs every check of the outputs and of the message that the action type calls for. Nothing is
+ * shown to the user before the transaction is known to be signable, so that a transaction that
+ * does not match its parameters fails at once, instead of at the end of its review.
+ */
+static bool check_bbn_transaction(dispatcher_context_t *dc, sign_psbt_state_t *st) {
     uint8_t psbt_txid[32];
     switch (g_bbn_data.action_type) {
         case BBN_POLICY_SLASHING:
@@ -277,9 +478,100 @@ bool validate_and_display_transaction(dispatcher_context_t *dc,
             }
             break;
         default:
+            SEND_SW(dc, SW_INCORRECT_DATA);
             return false;
     }
 
+    return true;
+}
+
+// Shows the action, its parameters, the outputs and the fee to the user, who may reject them.
+static bool review_bbn_transaction(dispatcher_context_t *dc,
+                                   sign_psbt_state_t *st,
+                                   const uint8_t internal_outputs[64],
+                                   bbn_bundle_state_t bundle_state) {
+    if (g_bbn_data.action_type == BBN_POLICY_BIP322) {
+        if (!ui_confirm_bbn_message(dc)) {
+            PRINTF("ui_confirm_bbn_message failed\n");
+            SEND_SW(dc, SW_DENY);
+            return false;
+        }
+    } else if (bundle_state == BBN_BUNDLE_PENDING_REVIEW) {
+        if (!display_bundle_actions(dc, bbn_session_bundle_actions())) {
+            PRINTF("display_bundle_actions failed\n");
+            SEND_SW(dc, SW_DENY);
+            return false;
+        }
+    } else if (bundle_state == BBN_BUNDLE_NONE) {
+        if (!display_actions(dc, g_bbn_data.action_type)) {
+            PRINTF("display_actions failed\n");
+            SEND_SW(dc, SW_DENY);
+            return false;
+        }
+    }
+
+    if (BBN_DATA_HAS(BBN_FIELD_FP_LIST) && bundle_state != BBN_BUNDLE_REVIEWED) {
+        if (!display_public_keys(dc, g_bbn_data.fp_count, bbn_data_fp_keys(), BBN_DIS_PUB_FP, 0)) {
+            PRINTF("display_public_keys failed\n");
+            return false;
+        }
+    }
+
+    if (BBN_DATA_HAS(BBN_FIELD_COV_KEY_LIST) && bundle_state != BBN_BUNDLE_REVIEWED) {
+        // a known committee is reviewed by name, on a single screen
+        const char *committee = bbn_covenant_known_committee();
+        if (committee != NULL) {
+            if (!display_covenant_committee(dc,
+                                            committee,
+                                            g_bbn_data.cov_key_count,
+                                            g_bbn_data.cov_quorum)) {
+                PRINTF("display_covenant_committee failed\n");
+                return false;
+            }
+        } else if (!display_public_keys(dc,
+                                        g_bbn_data.cov_key_count,
+                                        bbn_data_cov_keys(),
+                                        BBN_DIS_PUB_COV,
+                                        g_bbn_data.cov_quorum)) {
+            PRINTF("display_public_keys failed\n");
+            return false;
+        }
+    }
+    if (BBN_DATA_HAS(BBN_FIELD_TIMELOCK) && bundle_state == BBN_BUNDLE_PENDING_REVIEW) {
+        // every timelock the bundle will sign is reviewed now, whichever transaction comes first
+        uint8_t actions = bbn_session_bundle_actions();
+        uint32_t staking_timelock = 0;
+        uint32_t unbonding_timelock = 0;
+        if (actions & (1 << BBN_POLICY_STAKE_TRANSFER)) {
+            staking_timelock = (uint32_t) bbn_data_timelock(BBN_POLICY_STAKE_TRANSFER);
+        }
+        if (actions & BBN_BUNDLE_UNBONDING_ACTIONS) {
+            unbonding_timelock = (uint32_t) bbn_data_timelock(BBN_POLICY_UNBOND);
+        }
+        if (!display_bundle_timelocks(dc, staking_timelock, unbonding_timelock)) {
+            PRINTF("display_bundle_timelocks failed\n");
+            return false;
+        }
+    } else if (BBN_DATA_HAS(BBN_FIELD_TIMELOCK) && bundle_state == BBN_BUNDLE_NONE) {
+        if (g_bbn_data.action_type != BBN_POLICY_SLASHING &&
+            g_bbn_data.action_type != BBN_POLICY_SLASHING_UNBONDING) {
+            if (!display_timelock(dc, (uint32_t) bbn_data_timelock(g_bbn_data.action_type))) {
+                PRINTF("display_timelock failed\n");
+                return false;
+            }
+        }
+    }
+
+    if (!display_external_outputs(dc, st, internal_outputs)) {
+        PRINTF("display_external_outputs fail \n");
+        return false;
+    }
+
+    if (st->warnings.high_fee && !ui_warn_high_fee(dc)) {
+        PRINTF("ui_warn_high_fee fail \n");
+        SEND_SW(dc, SW_DENY);
+        return false;
+    }
     uint64_t fee = st->inputs_total_amount - st->outputs.total_amount;
     if (!ui_validate_transaction(dc, COIN_COINID_SHORT, fee, false)) {
         PRINTF("ui_validate_transaction fail \n");
@@ -290,22 +582,52 @@ bool validate_and_display_transaction(dispatcher_context_t *dc,
     return true;
 }
 
-/**
- * @brief Signs the custom (special) input.
- *
- * This function must be implemented in order to sign for all the inputs that are not internal.
- * If not implemented, only the internal inputs are signed (handled by the base app).
- *
- * This function must return false in case of any error. In that case, an error status word should
- * be sent. If the function returns true, no status word should be sent.
- *
- * @param dc Dispatcher context.
- * @param st PSBT signing state.
- * @param tx_hashes Transaction hashes.
- * @param internal_inputs Bitvector representing internal inputs.
- * @return true if signing was successful, false otherwise.
- */
-bool sign_custom_inputs(
+static bool validate_bbn_transaction(dispatcher_context_t *dc,
+                                     sign_psbt_state_t *st,
+                                     const uint8_t internal_outputs[64]) {
+    PRINTF("g_bbn_data.derive_path_len: %d\n", g_bbn_data.derive_path_len);
+    PRINTF("g_bbn_data.derive_path: ");
+    for (size_t i = 0; i < g_bbn_data.derive_path_len; i++) {
+        PRINTF("0x%x ", g_bbn_data.derive_path[i]);
+    }
+    PRINTF("\n");
+
+    // get staker public key
+    // use path from psbt
+    uint8_t pubkey[32];
+    if (!bbn_derive_pubkey(g_bbn_data.derive_path, g_bbn_data.derive_path_len, pubkey)) {
+        PRINTF("Failed to derive pubkey\n");
+        return false;
+    }
+    // TODO:
+    // need to compare the staker pk in taproot script if have
+    // every Babylon script commits to the staker key: the trees built so far are kept for the
+    // same key, as when one delegation signs several transactions in a row
+    if (!BBN_DATA_HAS(BBN_FIELD_STAKER_PK) || memcmp(g_bbn_data.staker_pk, pubkey, 32) != 0) {
+        memcpy(g_bbn_data.staker_pk, pubkey, 32);
+        g_bbn_data.fields |= BBN_FIELD(BBN_FIELD_STAKER_PK);
+        bbn_taptree_invalidate();
+    }
+    PRINTF("g_bbn_data.staker_pk: ");
+    PRINTF_BUF(g_bbn_data.staker_pk, 32);
+    PRINTF("action_type: %d\n", g_bbn_data.action_type);
+
+    if (!check_bbn_transaction(dc, st)) {
+        return false;
+    }
+
+    // in a bundle, the action list and the shared parameters are only reviewed once
+    bbn_bundle_state_t bundle_state = bbn_session_bundle_state(g_bbn_data.action_type, pubkey);
+    PRINTF("bundle_state: %d\n", bundle_state);
+    if (!review_bbn_transaction(dc, st, internal_outputs, bundle_state)) {
+        return false;
+    }
+
+    bbn_session_bundle_consume(g_bbn_data.action_type, pubkey);
+    return true;
+}
+
+static bool sign_bbn_inputs(
     dispatcher_context_t *dc,
     sign_psbt_state_t *st,
     tx_hashes_t *tx_hashes,
@@ -371,8 +693,7 @@ bool sign_custom_inputs(
             PRINTF("Signing external input %d\n", i);
             // 获取当前输入的map
             merkleized_map_commitment_t input_map;
-            if (0 > call_get_merkleized_map(dc, st->inputs_root, st->n_inputs, i, &input_map)) {
-                PRINTF("Failed to get input map for input %d\n", i);
+            if (!bbn_psbt_get_input_map(dc, st, i, &input_map)) {
                 return false;
             }
             int segwit_version = get_policy_segwit_version(st->wallet_policy_map);
@@ -380,36 +701,27 @@ bool sign_custom_inputs(
             uint8_t sighash[32];
             uint8_t leafhash[32];
             uint8_t *pLeaf = NULL;
+            bbn_leaf_t leaf = BBN_LEAF_COUNT;  // key path spend unless a leaf is selected
             switch (g_bbn_data.action_type) {
                 case BBN_POLICY_SLASHING:
                 case BBN_POLICY_SLASHING_UNBONDING:
-                    compute_bbn_leafhash_slashing(leafhash);
-                    pLeaf = leafhash;
-                    segwit_version = 1;  // force taproot
+                    leaf = BBN_LEAF_SLASHING;
                     break;
                 case BBN_POLICY_STAKE_TRANSFER:
-                    pLeaf = NULL;
                     break;
                 case BBN_POLICY_UNBOND:
-                    compute_bbn_leafhash_unbonding(leafhash);
-                    pLeaf = leafhash;
-                    segwit_version = 1;  // force taproot
+                    leaf = BBN_LEAF_UNBONDING;
                     break;
                 case BBN_POLICY_WITHDRAW:
-                    compute_bbn_leafhash_timelock(leafhash);
-                    pLeaf = leafhash;
-                    segwit_version = 1;  // force taproot
+                    leaf = BBN_LEAF_TIMELOCK;
                     break;
                 case BBN_POLICY_EXPANSION:
                     if (i == 0) {
                         // Input[0]: staking output, needs script path (unbonding script)
-                        compute_bbn_leafhash_unbonding(leafhash);
-                        pLeaf = leafhash;
-                        segwit_version = 1;  // force taproot
+                        leaf = BBN_LEAF_UNBONDING;
                         PRINTF("Input[0]: Using script path with unbonding leaf\n");
                     } else if (i == 1) {
                         // Input[1]: normal UTXO, use key path (no script)
-                        pLeaf = NULL;
                     } else {
                         //not possible
                         PRINTF("more then two input for expansion\n");
@@ -419,6 +731,16 @@ bool sign_custom_inputs(
                 default:
                     break;
             }
+            if (leaf != BBN_LEAF_COUNT) {
+                // the leaf hashes are computed once, and shared by all the inputs
+                if (!bbn_taptree_leafhash(leaf, leafhash)) {
+                    PRINTF("Failed to compute leaf hash for input %d\n", i);
+                    SEND_SW(dc, SW_INCORRECT_DATA);
+                    return false;
+                }
+                pLeaf = leafhash;
+                segwit_version = 1;  // force taproot
+            }
 
             if (segwit_version == 0)  // native segwit
             {
@@ -444,6 +766,7 @@ bool sign_custom_inputs(
                 PRINTF_BUF(script_pubkey, script_len);
 
                 // segwitv0 inputs default to SIGHASH_ALL
+                BBN_TRACE_BEGIN(BBN_TRACE_SIGHASH);
                 if (!compute_sighash_segwitv0(dc,
                                               st,
                                               tx_hashes,
@@ -452,8 +775,11 @@ bool sign_custom_inputs(
                                               script_pubkey,
                                               script_len,
                                               SIGHASH_ALL,
-                                              sighash))
+                                              sighash)) {
+                    BBN_TRACE_FAIL(BBN_TRACE_SIGHASH);
                     return false;
+                }
+                BBN_TRACE_END(BBN_TRACE_SIGHASH);
                 PRINTF("sighash: ");
                 PRINTF_BUF(sighash, 32);
 
@@ -466,6 +792,7 @@ bool sign_custom_inputs(
                                                   sighash))
                     return false;
             } else if (segwit_version == 1) {  // taproot
+                BBN_TRACE_BEGIN(BBN_TRACE_SIGHASH);
                 if (!compute_sighash_segwitv1(dc,
                                               st,
                                               tx_hashes,
@@ -477,8 +804,10 @@ bool sign_custom_inputs(
                                               SIGHASH_DEFAULT,
                                               sighash)) {
                     PRINTF("Failed to compute sighash for input %d\n", i);
+                    BBN_TRACE_FAIL(BBN_TRACE_SIGHASH);
                     return false;
                 }
+                BBN_TRACE_END(BBN_TRACE_SIGHASH);
                 PRINTF("sighash: ");
                 PRINTF_BUF(sighash, 32);
                 uint8_t dummy[128];
@@ -517,4 +846,34 @@ bool sign_custom_inputs(
 
     PRINTF("Signed external input\n");
     return true;
-}
\ No newline at end of file
+}
+
+/**
+ * @brief Signs the custom (special) input.
+ *
+ * This function must be implemented in order to sign for all the inputs that are not internal.
+ * If not implemented, only the internal inputs are signed (handled by the base app).
+ *
+ * This function must return false in case of any error. In that case, an error status word should
+ * be sent. If the function returns true, no status word should be sent.
+ *
+ * @param dc Dispatcher context.
+ * @param st PSBT signing state.
+ * @param tx_hashes Transaction hashes.
+ * @param internal_inputs Bitvector representing internal inputs.
+ * @return true if signing was successful, false otherwise.
+ */
+bool sign_custom_inputs(
+    dispatcher_context_t *dc,
+    sign_psbt_state_t *st,
+    tx_hashes_t *tx_hashes,
+    const uint8_t internal_inputs[static BITVECTOR_REAL_SIZE(MAX_N_INPUTS_CAN_SIGN)]) {
+    BBN_STACK_ENTER(BBN_STACK_SIGN_INPUTS);
+    BBN_TRACE_BEGIN(BBN_TRACE_SIGN_INPUTS);
+    bool result = sign_bbn_inputs(dc, st, tx_hashes, internal_inputs);
+    BBN_TRACE_CLOSE(BBN_TRACE_SIGN_INPUTS, result);
+    BBN_STACK_LEAVE(BBN_STACK_SIGN_INPUTS);
+    // the private keys derived for this PSBT do not outlive it, whatever the outcome
+    bbn_keycache_wipe_private();
+    return result;
+}
@@ -0,0 +1,192 @@
+from contextlib import contextmanager
+from dataclasses import dataclass, field
+from pathlib import Path
+from typing import Dict, Generator, List, Optional
+
+from ragger.backend.interface import BackendInterface, RAPDU
+from ragger.error import ExceptionRAPDU
+
+# Records every APDU exchanged with the app during a test, and sums them up per phase: one phase
+# is one command of the host (e.g. the upload of the Babylon parameters, or SIGN_PSBT), together
+# with all the client commands the app interrupts it with.
+
+CLA_BITCOIN = 0xE1
+CLA_FRAMEWORK = 0xF8
+INS_CONTINUE = 0x01
+
+SW_OK = 0x9000
+SW_INTERRUPTED_EXECUTION = 0xE000
+
+COMMAND_NAMES = {
+    (CLA_BITCOIN, 0x00): "get_extended_pubkey",
+    (CLA_BITCOIN, 0x02): "register_wallet",
+    (CLA_BITCOIN, 0x03): "get_wallet_address",
+    (CLA_BITCOIN, 0x04): "sign_psbt",
+    (CLA_BITCOIN, 0x05): "get_master_fingerprint",
+    (CLA_BITCOIN, 0x10): "sign_message",
+}
+
+INS_CUSTOM_TLV = 0xBB
+CUSTOM_TLV_NAMES = {0x00: "tlv_upload", 0x01: "tlv_reuse", 0x02: "tlv_bundle",
+                    0xD0: "debug_trace", 0xD1: "debug_stack", 0xD2: "debug_hash"}
+
+# client commands, i.e. the first byte of the data of an interruption
+CCMD_YIELD = 0x10
+CCMD_GET_PREIMAGE = 0x40
+CCMD_GET_MERKLE_LEAF_PROOF = 0x41
+CCMD_GET_MERKLE_LEAF_INDEX = 0x42
+CCMD_GET_MORE_ELEMENTS = 0xA0
+CCMD_GET_LEAVES = 0x50
+
+
+def command_name(cla: int, ins: int, p1: int) -> str:
+    if cla == CLA_BITCOIN and ins == INS_CUSTOM_TLV:
+        return CUSTOM_TLV_NAMES.get(p1, f"custom_tlv_{p1:02x}")
+    return COMMAND_NAMES.get((cla, ins), f"{cla:02x}_{ins:02x}")
+
+
+@dataclass
+class Exchange:
+    phase: str
+    apdu: bytes
+    status: int
+    response: bytes
+
+    @property
+    def client_command(self) -> Optional[int]:
+        if self.status == SW_INTERRUPTED_EXECUTION and len(self.response) > 0:
+            return self.response[0]
+        return None
+
+
+@dataclass
+class PhaseTotals:
+    round_trips: int = 0
+    bytes_in: int = 0  # host to device, whole APDUs
+    bytes_out: int = 0  # device to host, data and status word
+    interruptions: int = 0
+    merkle_proofs: int = 0
+    preimages: int = 0
+    leaf_indexes: int = 0
+    more_elements: int = 0
+    yields: int = 0
+
+    def add(self, exchange: Exchange) -> None:
+        self.round_trips += 1
+        self.bytes_in += len(exchange.apdu)
+        self.bytes_out += len(exchange.response) + 2
+        ccmd = exchange.client_command
+        if ccmd is None:
+            return
+        self.interruptions += 1
+        if ccmd == CCMD_GET_MERKLE_LEAF_PROOF:
+            self.merkle_proofs += 1
+        elif ccmd in (CCMD_GET_PREIMAGE, CCMD_GET_LEAVES):
+            self.preimages += 1
+        elif ccmd == CCMD_GET_MERKLE_LEAF_INDEX:
+            self.leaf_indexes += 1
+        elif ccmd == CCMD_GET_MORE_ELEMENTS:
+            self.more_elements += 1
+        elif ccmd == CCMD_YIELD:
+            self.yields += 1
+
+
+TABLE_COLUMNS = ["round_trips", "bytes_in", "bytes_out", "interruptions", "merkle_proofs",
+                 "preimages", "leaf_indexes", "more_elements", "yields"]
+
+
+@dataclass
+class ApduRecorder:
+    """
+    Wraps the raw exchanges of a ragger backend. Use as a context manager around the flow to
+    record, and `flow` to name the phases recorded inside of it.
+    """
+    backend: BackendInterface
+    exchanges: List[Exchange] = field(default_factory=list)
+    _flow: str = ""
+    _phase: str = ""
+
+    def __enter__(self) -> "ApduRecorder":
+        # the backend methods are shadowed on the instance, then uncovered again on exit
+        self._exchange_raw = self.backend.exchange_raw
+        self._exchange_async_raw = self.backend.exchange_async_raw
+        setattr(self.backend, "exchange_raw", self._recorded_exchange_raw)
+        setattr(self.backend, "exchange_async_raw", self._recorded_exchange_async_raw)
+        return self
+
+    def __exit__(self, *args) -> None:
+        delattr(self.backend, "exchange_raw")
+        delattr(self.backend, "exchange_async_raw")
+
+    @contextmanager
+    def flow(self, name: str) -> Generator[None, None, None]:
+        previous = self._flow
+        self._flow = name
+        try:
+            yield
+        finally:
+            self._flow = previous
+
+    def _start(self, apdu: bytes) -> None:
+        # continuations of an interrupted command belong to the phase of that command
+        if apdu[0] != CLA_FRAMEWORK or apdu[1] != INS_CONTINUE or not self._phase:
+            name = command_name(apdu[0], apdu[1], apdu[2])
+            self._phase = f"{self._flow}/{name}" if self._flow else name
+
+    def _record(self, apdu: bytes, status: int, response: bytes) -> None:
+        self.exchanges.append(Exchange(self._phase, bytes(apdu), status, bytes(response)))
+
+    def _recorded_exchange_raw(self, data: bytes = b"", tick_timeout: int = 5 * 60 * 10) -> RAPDU:
+        self._start(data)
+        try:
+            rapdu = self._exchange_raw(data, tick_timeout=tick_timeout)
+        except ExceptionRAPDU as e:
+            self._record(data, e.status, e.data or b"")
+            raise
+        self._record(data, rapdu.status, rapdu.data)
+        return rapdu
+
+    @contextmanager
+    def _recorded_exchange_async_raw(self, data: bytes = b"") -> Generator[None, None, None]:
+        self._start(data)
+        try:
+            with self._exchange_async_raw(data):
+                yield
+        except ExceptionRAPDU as e:
+            self._record(data, e.status, e.data or b"")
+            raise
+        rapdu = self.backend.last_async_response
+        if rapdu is not None:
+            self._record(data, rapdu.status, rapdu.data)
+
+    def totals(self) -> Dict[str, PhaseTotals]:
+        """Per-phase totals, in the order the phases were first seen."""
+        totals: Dict[str, PhaseTotals] = {}
+        for exchange in self.exchanges:
+            totals.setdefault(exchange.phase, PhaseTotals()).add(exchange)
+        return totals
+
+    def format_table(self) -> str:
+        rows = [["phase"] + TABLE_COLUMNS]
+        for phase, totals in self.totals().items():
+            rows.append([phase] + [str(getattr(totals, column)) for column in TABLE_COLUMNS])
+        widths = [max(len(row[i]) for row in rows) for i in range(len(rows[0]))]
+        lines = []
+        for row in rows:
+            cells = [row[0].ljust(widths[0])]
+            cells += [cell.rjust(width) for cell, width in zip(row[1:], widths[1:])]
+            lines.append("  ".join(cells).rstrip())
+        return "\n".join(lines) + "\n"
+
+    def format_transcript(self) -> str:
+        lines = []
+        for exchange in self.exchanges:
+            lines.append(f"{exchange.phase} => {exchange.apdu.hex()}")
+            lines.append(f"{exchange.phase} <= {exchange.response.hex()} {exchange.status:04x}")
+        return "\n".join(lines) + "\n"
+
+    def write(self, directory: Path, name: str) -> None:
+        """Writes `<name>.txt` (per-phase totals) and `<name>.apdus` (every exchange)."""
+        directory.mkdir(parents=True, exist_ok=True)
+        (directory / f"{name}.txt").write_text(self.format_table())
+        (directory / f"{name}.apdus").write_text(self.format_transcript())
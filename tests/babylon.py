@@ -0,0 +1,390 @@
+from dataclasses import dataclass
+from enum import IntEnum
+from hashlib import sha256
+from io import BytesIO
+from typing import Dict, List, Optional, Tuple
+
+from bip32 import BIP32
+from ledger_bitcoin.client_command import ClientCommand, ClientCommandInterpreter
+from ledger_bitcoin.common import read_varint, write_varint
+from ledger_bitcoin.merkle import MerkleTree, element_hash
+from ledger_bitcoin.psbt import PSBT, PartiallySignedInput, PartiallySignedOutput
+from ledger_bitcoin.tx import COutPoint, CTransaction, CTxIn, CTxOut
+from ledger_bitcoin.wallet import WalletPolicy
+from ragger_bitcoin import RaggerClient
+
+# Host side of the Babylon extension, for the tests: TLV parameters, their upload, and the PSBTs
+# of each action, built for the key of the Speculos seed.
+
+
+class BbnAction(IntEnum):
+    # bbn_action_type_t
+    SLASHING = 0
+    SLASHING_UNBONDING = 1
+    STAKE_TRANSFER = 2
+    UNBOND = 3
+    WITHDRAW = 4
+    BIP322 = 5
+    EXPANSION = 6
+
+
+TAG_ACTION_TYPE = 0x77
+TAG_FP_COUNT = 0xf9
+TAG_FP_LIST = 0xf8
+TAG_COV_KEY_COUNT = 0xc0
+TAG_COV_KEY_LIST = 0xc1
+TAG_COV_QUORUM = 0x01
+TAG_TIMELOCK = 0x71
+TAG_UNBONDING_TIMELOCK = 0x72
+TAG_SLASHING_FEE_LIMIT = 0xfe
+TAG_UNBONDING_FEE_LIMIT = 0xff
+TAG_MESSAGE = 0x33
+TAG_MESSAGE_KEY = 0x34
+TAG_BURN_ADDRESS = 0x36
+TAG_BIP32_PATH = 0x37
+
+INS_CUSTOM_TLV = 0xBB
+# INS_CUSTOM_TLV upload versions, in P2
+TLV_VERSION_0 = 0  # fixed 64-byte chunks, fetched with merkle proofs
+TLV_VERSION_CHUNKED = 1  # announced chunk size, fetched with merkle proofs
+TLV_VERSION_BULK = 2  # announced chunk size, leaves streamed in order with GET_LEAVES
+TLV_UPLOAD_VERSION = TLV_VERSION_CHUNKED
+# INS_CUSTOM_TLV sub-commands on cached parameters, in P1
+TLV_P1_REUSE = 0x01
+TLV_P1_BUNDLE = 0x02
+
+CCMD_GET_LEAVES = 0x50
+# largest data of an APDU, hence of the answer to a client command
+MAX_RESPONSE_LEN = 255
+
+STAKER_PATH = "m/86'/1'/0'/0/0"
+HARDENED = 0x80000000
+
+# Babylon signet parameters, from data/step12_slasing
+FP_PK = bytes.fromhex("d66124f8f42fd83e4c901a100ae3b5d706ef6cfd217b04bc64152e739a30c41e")
+COV_PKS = [bytes.fromhex(pk) for pk in [
+    "0aee0509b16db71c999238a4827db945526859b13c95487ab46725357c9a9f25",
+    "113c3a32a9d320b72190a04a020a0db3976ef36972673258e9a38a364f3dc3b0",
+    "17921cf156ccb4e73d428f996ed11b245313e37e27c978ac4d2cc21eca4672e4",
+    "3bb93dfc8b61887d771f3630e9a63e97cbafcfcc78556a474df83a31a0ef899c",
+    "40afaf47c4ffa56de86410d8e47baa2bb6f04b604f4ea24323737ddc3fe092df",
+    "79a71ffd71c503ef2e2f91bccfc8fcda7946f4653cef0d9f3dde20795ef3b9f0",
+    "d21faf78c6751a0d38e6bd8028b907ff07e9a869a43fc837d6b3f8dff6119a36",
+    "f5199efae3f28bb82476163a7e458c7ad445d9bffb0682d10d3bdb2cb41f8e8e",
+    "fa9d882d45f4060bdb8042183828cd87544f1ea997380e586cab77d5fd698737",
+]]
+COV_QUORUM = 6
+STAKING_TIMELOCK = 64000
+UNBONDING_TIMELOCK = 1008
+FEE = 1000
+BURN_SCRIPT = bytes.fromhex("0014") + bytes(20)
+MESSAGE = b"Babylon BIP-322 transcript"
+
+NUMS_KEY = bytes.fromhex("50929b74c1a04954b78b4b6035e97a5e078a5a0f28ec96d547bfee9ace803ac0")
+
+# secp256k1, just enough for the taproot tweak of the outputs
+P = 0xFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFEFFFFFC2F
+N = 0xFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFEBAAEDCE6AF48A03BBFD25E8CD0364141
+G = (0x79BE667EF9DCBBAC55A06295CE870B07029BFCDB2DCE28D959F2815B16F81798,
+     0x483ADA7726A3C4655DA4FBFC0E1108A8FD17B448A68554199C47D08FFB10D4B8)
+
+Point = Optional[Tuple[int, int]]
+
+
+def point_add(p1: Point, p2: Point) -> Point:
+    if p1 is None:
+        return p2
+    if p2 is None:
+        return p1
+    if p1[0] == p2[0] and p1[1] != p2[1]:
+        return None
+    if p1 == p2:
+        lam = 3 * p1[0] * p1[0] * pow(2 * p1[1], P - 2, P) % P
+    else:
+        lam = (p2[1] - p1[1]) * pow(p2[0] - p1[0], P - 2, P) % P
+    x = (lam * lam - p1[0] - p2[0]) % P
+    return (x, (lam * (p1[0] - x) - p1[1]) % P)
+
+
+def point_mul(point: Point, n: int) -> Point:
+    result = None
+    for i in range(256):
+        if (n >> i) & 1:
+            result = point_add(result, point)
+        point = point_add(point, point)
+    return result
+
+
+def lift_x(x: bytes) -> Point:
+    x_int = int.from_bytes(x, "big")
+    y = pow((pow(x_int, 3, P) + 7) % P, (P + 1) // 4, P)
+    return (x_int, y if y % 2 == 0 else P - y)
+
+
+def tagged_hash(tag: str, data: bytes) -> bytes:
+    tag_hash = sha256(tag.encode()).digest()
+    return sha256(tag_hash + tag_hash + data).digest()
+
+
+def tapleaf_hash(script: bytes) -> bytes:
+    return tagged_hash("TapLeaf", b"\xc0" + write_varint(len(script)) + script)
+
+
+def tapbranch_hash(left: bytes, right: bytes) -> bytes:
+    return tagged_hash("TapBranch", min(left, right) + max(left, right))
+
+
+def taproot_output_key(internal_key: bytes, root: bytes = b"") -> bytes:
+    tweak = int.from_bytes(tagged_hash("TapTweak", internal_key + root), "big")
+    output = point_add(lift_x(internal_key), point_mul(G, tweak))
+    assert output is not None
+    return output[0].to_bytes(32, "big")
+
+
+def p2tr_script(output_key: bytes) -> bytes:
+    return b"\x51\x20" + output_key
+
+
+# Babylon tapscripts, as built by src/bbn_script.c
+
+def script_number(value: int) -> bytes:
+    if value <= 16:
+        return bytes([0x50 + value])
+    data = value.to_bytes((value.bit_length() + 8) // 8, "little")
+    return bytes([len(data)]) + data
+
+
+def covenant_multisig() -> bytes:
+    script = b""
+    for i, key in enumerate(COV_PKS):
+        script += b"\x20" + key + (b"\xac" if i == 0 else b"\xba")
+    return script + bytes([0x50 + COV_QUORUM, 0x9c])
+
+
+def slashing_script(staker_pk: bytes) -> bytes:
+    return b"\x20" + staker_pk + b"\xad" + b"\x20" + FP_PK + b"\xad" + covenant_multisig()
+
+
+def unbonding_script(staker_pk: bytes) -> bytes:
+    return b"\x20" + staker_pk + b"\xad" + covenant_multisig()
+
+
+def timelock_script(staker_pk: bytes, timelock: int) -> bytes:
+    return b"\x20" + staker_pk + b"\xad" + script_number(timelock) + b"\xb2"
+
+
+def staking_output_key(staker_pk: bytes) -> bytes:
+    branch = tapbranch_hash(tapleaf_hash(unbonding_script(staker_pk)),
+                            tapleaf_hash(timelock_script(staker_pk, STAKING_TIMELOCK)))
+    root = tapbranch_hash(tapleaf_hash(slashing_script(staker_pk)), branch)
+    return taproot_output_key(NUMS_KEY, root)
+
+
+def unbonding_output_key(staker_pk: bytes) -> bytes:
+    root = tapbranch_hash(tapleaf_hash(slashing_script(staker_pk)),
+                          tapleaf_hash(timelock_script(staker_pk, UNBONDING_TIMELOCK)))
+    return taproot_output_key(NUMS_KEY, root)
+
+
+def change_output_key(staker_pk: bytes) -> bytes:
+    return taproot_output_key(NUMS_KEY, tapleaf_hash(timelock_script(staker_pk,
+                                                                      UNBONDING_TIMELOCK)))
+
+
+# TLV parameters
+
+def encode_tlv(entries: List[Tuple[int, bytes]]) -> bytes:
+    return b"".join(bytes([tag]) + len(value).to_bytes(2, "big") + value
+                    for tag, value in entries)
+
+
+def encode_path(path: str) -> bytes:
+    data = b""
+    for step in path.split("/")[1:]:
+        index = int(step.rstrip("'")) + (HARDENED if step.endswith("'") else 0)
+        data += index.to_bytes(4, "big")
+    return data
+
+
+def script_parameters(timelock: int) -> List[Tuple[int, bytes]]:
+    """The parameters of the staking, unbonding and slashing scripts, and of their checks."""
+    return [
+        (TAG_FP_COUNT, b"\x01"),
+        (TAG_FP_LIST, FP_PK),
+        (TAG_COV_KEY_COUNT, bytes([len(COV_PKS)])),
+        (TAG_COV_KEY_LIST, b"".join(COV_PKS)),
+        (TAG_COV_QUORUM, bytes([COV_QUORUM])),
+        (TAG_TIMELOCK, timelock.to_bytes(8, "big")),
+        (TAG_SLASHING_FEE_LIMIT, FEE.to_bytes(8, "big")),
+        (TAG_UNBONDING_FEE_LIMIT, FEE.to_bytes(8, "big")),
+        (TAG_BURN_ADDRESS, BURN_SCRIPT),
+    ]
+
+
+def action_parameters(action: BbnAction, message_key: bytes = b"") -> bytes:
+    entries = [(TAG_ACTION_TYPE, bytes([action])), (TAG_BIP32_PATH, encode_path(STAKER_PATH))]
+    if action == BbnAction.BIP322:
+        entries += [(TAG_MESSAGE, MESSAGE), (TAG_MESSAGE_KEY, message_key)]
+        return encode_tlv(entries)
+
+    # the slashing transactions lock their change with the unbonding time
+    staking = action in (BbnAction.STAKE_TRANSFER, BbnAction.EXPANSION, BbnAction.WITHDRAW)
+    timelock = STAKING_TIMELOCK if staking else UNBONDING_TIMELOCK
+    return encode_tlv(entries + script_parameters(timelock))
+
+
+def delegation_parameters() -> bytes:
+    """
+    The parameters of a whole delegation, without an action type: the staking timelock for the
+    staking output, and the unbonding one for the unbonding output and the slashing change.
+    """
+    entries = [(TAG_BIP32_PATH, encode_path(STAKER_PATH))] + script_parameters(STAKING_TIMELOCK)
+    entries.append((TAG_UNBONDING_TIMELOCK, UNBONDING_TIMELOCK.to_bytes(8, "big")))
+    return encode_tlv(entries)
+
+
+class GetLeavesCommand(ClientCommand):
+    """
+    GET_LEAVES (0x50) of the bulk upload: the device asks for the leaves of a known merkle tree
+    from an index on, and gets their count then the leaves, as many as fit in one response.
+    """
+
+    def __init__(self) -> None:
+        self.known_lists: Dict[bytes, List[bytes]] = {}
+
+    @property
+    def code(self) -> int:
+        return CCMD_GET_LEAVES
+
+    def add_known_list(self, leaves: List[bytes]) -> None:
+        self.known_lists[MerkleTree([element_hash(leaf) for leaf in leaves]).root] = leaves
+
+    def execute(self, request: bytes) -> bytes:
+        req = BytesIO(request[1:])
+        root = req.read(32)
+        index = read_varint(req)
+        if root not in self.known_lists or req.read():
+            raise ValueError("Invalid GET_LEAVES request")
+        leaves = self.known_lists[root]
+        if index >= len(leaves):
+            raise ValueError(f"GET_LEAVES index out of range: {index}")
+
+        response = b""
+        count = 0
+        while (index + count < len(leaves)
+               and 1 + len(response) + len(leaves[index + count]) <= MAX_RESPONSE_LEN):
+            response += leaves[index + count]
+            count += 1
+        return bytes([count]) + response
+
+
+def upload_parameters(client: RaggerClient, tlv: bytes, chunk_size: int = 64,
+                      version: int = TLV_UPLOAD_VERSION) -> bytes:
+    """Uploads the TLV parameters with INS_CUSTOM_TLV, and returns their hash."""
+    if version == TLV_VERSION_0:
+        chunk_size = 64
+    chunks = [tlv[i:i + chunk_size] for i in range(0, len(tlv), chunk_size)]
+    interpreter = ClientCommandInterpreter()
+    interpreter.add_known_list(chunks)
+    if version == TLV_VERSION_BULK:
+        get_leaves = GetLeavesCommand()
+        get_leaves.add_known_list(chunks)
+        interpreter.commands[get_leaves.code] = get_leaves
+    root = MerkleTree([element_hash(chunk) for chunk in chunks]).root
+    data = write_varint(len(tlv)) + root
+    if version != TLV_VERSION_0:
+        data += write_varint(chunk_size)
+    sw, response = client._make_request({"cla": 0xE1, "ins": INS_CUSTOM_TLV, "p1": 0x00,
+                                         "p2": version, "data": data}, interpreter)
+    assert sw == 0x9000
+    assert response == sha256(tlv).digest()
+    return response
+
+
+def reuse_parameters(client: RaggerClient, tlv_hash: bytes,
+                     action: Optional[BbnAction] = None) -> None:
+    """Reloads cached parameters, for the given action if any."""
+    data = tlv_hash + (bytes([action]) if action is not None else b"")
+    sw, response = client._make_request({"cla": 0xE1, "ins": INS_CUSTOM_TLV, "p1": TLV_P1_REUSE,
+                                         "p2": 0x00, "data": data})
+    assert sw == 0x9000
+    assert response == tlv_hash
+
+
+def begin_bundle(client: RaggerClient, tlv_hash: bytes, actions: List[BbnAction]) -> None:
+    """Starts a bundle of the given actions, signed with cached parameters."""
+    mask = sum(1 << action for action in actions)
+    sw, response = client._make_request({"cla": 0xE1, "ins": INS_CUSTOM_TLV, "p1": TLV_P1_BUNDLE,
+                                         "p2": 0x00, "data": tlv_hash + bytes([mask])})
+    assert sw == 0x9000
+    assert response == tlv_hash
+
+
+# PSBTs
+
+@dataclass
+class Utxo:
+    txid: bytes  # internal byte order
+    amount: int
+    script: bytes
+
+
+def make_psbt(inputs: List[Utxo], outputs: List[Tuple[int, bytes]], version: int = 2) -> PSBT:
+    tx = CTransaction()
+    tx.nVersion = version
+    tx.vin = [CTxIn(COutPoint(int.from_bytes(utxo.txid, "little"), 0), nSequence=0xffffffff)
+              for utxo in inputs]
+    tx.vout = [CTxOut(amount, script) for amount, script in outputs]
+    psbt = PSBT()
+    psbt.tx = tx
+    psbt.inputs = []
+    for utxo in inputs:
+        psbt_in = PartiallySignedInput(0)
+        psbt_in.witness_utxo = CTxOut(utxo.amount, utxo.script)
+        psbt.inputs.append(psbt_in)
+    psbt.outputs = [PartiallySignedOutput(0) for _ in outputs]
+    return psbt
+
+
+def bip322_to_spend_txid(message_key: bytes) -> bytes:
+    msg_hash = tagged_hash("BIP0322-signed-message", MESSAGE)
+    tx = (bytes(4) + b"\x01" + bytes(32) + b"\xff\xff\xff\xff" + b"\x22\x00\x20" + msg_hash
+          + bytes(4) + b"\x01" + bytes(8) + b"\x22" + p2tr_script(message_key) + bytes(4))
+    return sha256(sha256(tx).digest()).digest()
+
+
+def staker_key(client: RaggerClient) -> bytes:
+    xpub = client.get_extended_pubkey(STAKER_PATH)
+    return BIP32.from_xpub(xpub).get_pubkey_from_path("m")[1:]
+
+
+def default_wallet(client: RaggerClient) -> WalletPolicy:
+    fpr = client.get_master_fingerprint().hex()
+    xpub = client.get_extended_pubkey("m/86'/1'/0'")
+    return WalletPolicy("", "tr(@0/**)", [f"[{fpr}/86'/1'/0']{xpub}"])
+
+
+def action_psbt(action: BbnAction, staker_pk: bytes) -> PSBT:
+    """A PSBT that passes the checks of the app for the given action."""
+    staking = Utxo(bytes(range(32)), 50000, p2tr_script(staking_output_key(staker_pk)))
+    wallet_utxo = Utxo(bytes(range(1, 33)), 60000, p2tr_script(taproot_output_key(staker_pk)))
+    refund = p2tr_script(taproot_output_key(staker_pk))
+
+    if action == BbnAction.STAKE_TRANSFER:
+        return make_psbt([wallet_utxo], [(50000, staking.script), (10000 - FEE, refund)])
+    if action == BbnAction.EXPANSION:
+        return make_psbt([staking, wallet_utxo],
+                         [(100000, staking.script), (10000 - FEE, refund)])
+    if action == BbnAction.UNBOND:
+        unbonding = p2tr_script(unbonding_output_key(staker_pk))
+        return make_psbt([staking], [(staking.amount - FEE, unbonding)])
+    if action in (BbnAction.SLASHING, BbnAction.SLASHING_UNBONDING):
+        change = p2tr_script(change_output_key(staker_pk))
+        return make_psbt([staking], [(5000, BURN_SCRIPT), (staking.amount - 5000 - FEE, change)])
+    if action == BbnAction.WITHDRAW:
+        return make_psbt([staking], [(staking.amount - FEE, refund)])
+    if action == BbnAction.BIP322:
+        message_key = taproot_output_key(staker_pk)
+        to_spend = Utxo(bip322_to_spend_txid(message_key), 0, p2tr_script(message_key))
+        return make_psbt([to_spend], [(0, b"\x6a")], version=0)
+    raise ValueError(f"Unknown action {action}")
@@ -39,6 +39,8 @@ pytest_plugins = ("ragger.conftest.base_conftest", )
 
 def pytest_addoption(parser):
     parser.addoption("--network", default="test")
+    parser.addoption("--transcript-dir", default=str(TESTS_ROOT_DIR / "transcripts"),
+                     help="where test_apdu_transcript writes the APDU transcripts")
 
 @pytest.fixture
 def bitcoin_network(pytestconfig) -> Union[Literal['main'], Literal['test']]:
@@ -49,6 +51,11 @@ def bitcoin_network(pytestconfig) -> Union[Literal['main'], Literal['test']]:
     return network
 
 
+@pytest.fixture
+def transcript_dir(pytestconfig) -> Path:
+    return Path(pytestconfig.getoption("transcript_dir"))
+
+
 @pytest.fixture
 def client(bitcoin_network: str, backend: BackendInterface) -> RaggerClient:
     if bitcoin_network == "main":
@@ -0,0 +1,37 @@
+from pathlib import Path
+
+import pytest
+from ragger.backend.interface import BackendInterface
+from ragger.firmware import Firmware
+from ragger.navigator import Navigator
+from ragger_bitcoin import RaggerClient
+
+from .apdu_recorder import ApduRecorder
+from .babylon import (BbnAction, action_parameters, action_psbt, default_wallet, staker_key,
+                      taproot_output_key, upload_parameters)
+from .instructions import sign_psbt_instruction_approve
+
+# Records the full sign flow of each Babylon action: the upload of its parameters, then SIGN_PSBT.
+# Each flow writes <transcript-dir>/<device>/<action>.txt, with the round trips, bytes and client
+# commands of each phase, and <action>.apdus with every exchange; diff them between two builds.
+
+
+@pytest.mark.parametrize("action", list(BbnAction), ids=lambda action: action.name.lower())
+def test_apdu_transcript(client: RaggerClient, backend: BackendInterface, firmware: Firmware,
+                         navigator: Navigator, test_name: str, transcript_dir: Path,
+                         action: BbnAction):
+    staker_pk = staker_key(client)
+    wallet = default_wallet(client)
+    tlv = action_parameters(action, message_key=taproot_output_key(staker_pk))
+    psbt = action_psbt(action, staker_pk)
+
+    with ApduRecorder(backend) as recorder, recorder.flow(action.name.lower()):
+        upload_parameters(client, tlv)
+        result = client.sign_psbt(psbt, wallet, None, navigator=navigator,
+                                  instructions=sign_psbt_instruction_approve(
+                                      firmware, save_screenshot=False),
+                                  testname=test_name)
+
+    assert len(result) == len(psbt.inputs)
+    recorder.write(transcript_dir / firmware.name, action.name.lower())
+    print(recorder.format_table())
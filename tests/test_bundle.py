@@ -0,0 +1,31 @@
+from ragger.firmware import Firmware
+from ragger.navigator import Navigator
+from ragger_bitcoin import RaggerClient
+
+from .babylon import (BbnAction, action_psbt, begin_bundle, default_wallet,
+                      delegation_parameters, reuse_parameters, staker_key, upload_parameters)
+from .instructions import sign_psbt_instruction_approve
+
+# Signs the four transactions of a delegation as a bundle, with one parameter set holding both
+# the staking and the unbonding timelock. The first PSBT reviews the bundle, the next ones only
+# their outputs.
+
+DELEGATION = [BbnAction.STAKE_TRANSFER, BbnAction.SLASHING, BbnAction.UNBOND,
+              BbnAction.SLASHING_UNBONDING]
+
+
+def test_sign_delegation_bundle(client: RaggerClient, firmware: Firmware, navigator: Navigator,
+                                test_name: str):
+    staker_pk = staker_key(client)
+    wallet = default_wallet(client)
+
+    tlv_hash = upload_parameters(client, delegation_parameters())
+    begin_bundle(client, tlv_hash, DELEGATION)
+    for action in DELEGATION:
+        psbt = action_psbt(action, staker_pk)
+        reuse_parameters(client, tlv_hash, action)
+        result = client.sign_psbt(psbt, wallet, None, navigator=navigator,
+                                  instructions=sign_psbt_instruction_approve(
+                                      firmware, save_screenshot=False),
+                                  testname=f"{test_name}_{action.name.lower()}")
+        assert len(result) == len(psbt.inputs)
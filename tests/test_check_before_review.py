@@ -0,0 +1,27 @@
+import pytest
+from ragger.error import ExceptionRAPDU
+from ragger_bitcoin import RaggerClient
+
+from .babylon import (BbnAction, FEE, FP_PK, Utxo, action_parameters, default_wallet, make_psbt,
+                      p2tr_script, staker_key, staking_output_key, taproot_output_key,
+                      upload_parameters)
+
+SW_DENY = 0x6985
+
+# A Babylon PSBT is checked against the parameters before any of it is shown: one that cannot be
+# signed is rejected without a single screen, so no navigation is given to sign_psbt.
+
+
+def test_mismatched_staking_output_is_rejected_before_review(client: RaggerClient):
+    staker_pk = staker_key(client)
+    wallet = default_wallet(client)
+    wallet_utxo = Utxo(bytes(range(1, 33)), 60000, p2tr_script(taproot_output_key(staker_pk)))
+    refund = p2tr_script(taproot_output_key(staker_pk))
+    # a staking output for another staker key
+    other_staking = p2tr_script(staking_output_key(FP_PK))
+    psbt = make_psbt([wallet_utxo], [(50000, other_staking), (10000 - FEE, refund)])
+
+    upload_parameters(client, action_parameters(BbnAction.STAKE_TRANSFER))
+    with pytest.raises(ExceptionRAPDU) as e:
+        client.sign_psbt(psbt, wallet, None)
+    assert e.value.status == SW_DENY
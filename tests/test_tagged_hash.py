@@ -0,0 +1,26 @@
+import pytest
+from ragger.backend.interface import BackendInterface
+
+from .babylon import INS_CUSTOM_TLV, tagged_hash
+
+# The tagged hashes of the app start from precomputed SHA-256 midstates, written in the context of
+# the SDK. This checks them on the device, against the SDK initialiser and against hashlib, with
+# data of zero, one and more blocks. Debug builds only.
+
+P1_DEBUG_HASH = 0xD2
+
+# bbn_tag_t order
+TAGS = ["BIP0322-signed-message", "TapLeaf", "TapBranch", "TapTweak"]
+
+
+@pytest.mark.parametrize("length", [0, 1, 63, 64, 65, 150, 200])
+def test_tagged_hash_midstates(backend: BackendInterface, length: int):
+    data = bytes(i % 256 for i in range(length))
+    response = backend.exchange(cla=0xE1, ins=INS_CUSTOM_TLV, p1=P1_DEBUG_HASH, p2=0,
+                                data=data).data
+
+    assert len(response) == 1 + 32 * len(TAGS)
+    mismatch = response[0]
+    assert mismatch == 0, f"midstates differ from the SDK for tags {mismatch:#04x}"
+    for i, tag in enumerate(TAGS):
+        assert response[1 + 32 * i:1 + 32 * (i + 1)] == tagged_hash(tag, data), tag
@@ -0,0 +1,39 @@
+import pytest
+from ragger.firmware import Firmware
+from ragger.navigator import Navigator
+from ragger_bitcoin import RaggerClient
+
+from .babylon import (BbnAction, TLV_VERSION_0, TLV_VERSION_BULK, TLV_VERSION_CHUNKED,
+                      action_parameters, action_psbt, default_wallet, staker_key,
+                      upload_parameters)
+from .instructions import sign_psbt_instruction_approve
+
+# Uploads the parameters of a staking transaction with each version of INS_CUSTOM_TLV, then signs
+# it with them. The small chunks of the bulk upload take several GET_LEAVES rounds, and the 1-byte
+# ones one leaf per byte.
+
+
+@pytest.mark.parametrize("version, chunk_size", [
+    (TLV_VERSION_0, 64),
+    (TLV_VERSION_CHUNKED, 252),
+    (TLV_VERSION_BULK, 16),
+    (TLV_VERSION_BULK, 252),
+    (TLV_VERSION_BULK, 1),
+], ids=["v0", "chunked_252", "bulk_16", "bulk_252", "bulk_1"])
+def test_upload_and_sign(client: RaggerClient, firmware: Firmware, navigator: Navigator,
+                         test_name: str, version: int, chunk_size: int):
+    staker_pk = staker_key(client)
+    wallet = default_wallet(client)
+    tlv = action_parameters(BbnAction.STAKE_TRANSFER)
+    if version == TLV_VERSION_0:
+        # version 0 takes at most 15 chunks of 64 bytes
+        assert len(tlv) <= 15 * 64
+    psbt = action_psbt(BbnAction.STAKE_TRANSFER, staker_pk)
+
+    upload_parameters(client, tlv, chunk_size=chunk_size, version=version)
+    result = client.sign_psbt(psbt, wallet, None, navigator=navigator,
+                              instructions=sign_psbt_instruction_approve(
+                                  firmware, save_screenshot=False),
+                              testname=test_name)
+    assert len(result) == len(psbt.inputs)
+
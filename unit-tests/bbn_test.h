@@ -0,0 +1,40 @@
+/**
+ * Minimal test helpers for the host build: every failed check is reported, and the test returns
+ * a non-zero status if any of them failed.
+ */
+#pragma once
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+
+static int g_bbn_test_failures;
+
+#define CHECK(cond)                                                                     \
+    do {                                                                                \
+        if (!(cond)) {                                                                  \
+            fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond);    \
+            g_bbn_test_failures++;                                                      \
+        }                                                                               \
+    } while (0)
+
+#define CHECK_MEM(a, b, len) CHECK(memcmp((a), (b), (len)) == 0)
+
+#define RUN_TEST(fn)                                                                    \
+    do {                                                                                \
+        int failures_before = g_bbn_test_failures;                                      \
+        fn();                                                                           \
+        const char *status = g_bbn_test_failures == failures_before ? "[ OK ]" : "[FAIL]";\
+        printf("%s %s\n", status, #fn);                                                 \
+    } while (0)
+
+#define TEST_RESULT() (g_bbn_test_failures == 0 ? 0 : 1)
+
+// Parses a hex string of exactly 2 * len characters
+static inline void hex_to_bytes(const char *hex, uint8_t *out, size_t len) {
+    for (size_t i = 0; i < len; i++) {
+        unsigned int byte;
+        sscanf(hex + 2 * i, "%2x", &byte);
+        out[i] = (uint8_t) byte;
+    }
+}
@@ -0,0 +1,47 @@
+/**
+ * Babylon signet delegation used by the tests, from data/step12_slasing.
+ */
+#pragma once
+
+#define VEC_STAKER_PK "dc8d2f9eff0c4f4dbde070a48e330efc908b62a766568d91e658f284b324b878"
+#define VEC_FP_PK     "d66124f8f42fd83e4c901a100ae3b5d706ef6cfd217b04bc64152e739a30c41e"
+
+#define VEC_COV_COUNT  9
+#define VEC_COV_QUORUM 6
+static const char *const VEC_COV_PKS[VEC_COV_COUNT] = {
+    "0aee0509b16db71c999238a4827db945526859b13c95487ab46725357c9a9f25",
+    "113c3a32a9d320b72190a04a020a0db3976ef36972673258e9a38a364f3dc3b0",
+    "17921cf156ccb4e73d428f996ed11b245313e37e27c978ac4d2cc21eca4672e4",
+    "3bb93dfc8b61887d771f3630e9a63e97cbafcfcc78556a474df83a31a0ef899c",
+    "40afaf47c4ffa56de86410d8e47baa2bb6f04b604f4ea24323737ddc3fe092df",
+    "79a71ffd71c503ef2e2f91bccfc8fcda7946f4653cef0d9f3dde20795ef3b9f0",
+    "d21faf78c6751a0d38e6bd8028b907ff07e9a869a43fc837d6b3f8dff6119a36",
+    "f5199efae3f28bb82476163a7e458c7ad445d9bffb0682d10d3bdb2cb41f8e8e",
+    "fa9d882d45f4060bdb8042183828cd87544f1ea997380e586cab77d5fd698737",
+};
+
+// the staking output and the unbonding output use different timelocks
+#define VEC_STAKING_TIMELOCK 64000
+#define VEC_TIMELOCK         1008
+
+#define VEC_SLASHING_LEAFHASH  "ed429f93af8bb724a9f5066248b32d945fdd1c12f7f59a33f4f83b6565716750"
+#define VEC_TIMELOCK_LEAFHASH  "28be7913bb2c3a1cb55f071af09fd841e2c9fcac044e23d6089c9fe873ceccfa"
+// sibling of the slashing leaf in the staking output: the (unbonding, timelock) branch
+#define VEC_STAKING_BRANCH     "89b605f98831c3e526d9eb2179651452938a8c0ff7f5eaeeccb61251d5d46deb"
+#define VEC_STAKING_OUTPUT_KEY "d763de6b471e305641ba41d65c6782e8cbcff6e08e83daab0da1275bbc9faad0"
+#define VEC_UNBOND_OUTPUT_KEY  "12f969f572893b000dfab14da6ad0cdc834b13360d3f304621ee9acb9756ae53"
+#define VEC_CHANGE_OUTPUT_KEY  "2c95bad50a63d13aa818df8e4b6864181adbf4720a88aaf8e3c1235ba08a4d9f"
+
+/**
+ * Scripts the signet delegation does not cover, from an independent implementation of the Babylon
+ * script builder (keys sorted, numbers as with AddInt64), checked against the vectors above.
+ */
+// two FPs, the signet FP and the first covenant key, with an FP quorum of 1
+#define VEC_MULTI_FP_SLASHING_LEAFHASH  "510ea4393c2da4c620969e253c4bb30224ca215df83fc5bdb34448c8bcef8620"
+#define VEC_MULTI_FP_STAKING_OUTPUT_KEY "3db69245796c49df9dfc24b031f526011116cd37903f7e9bd5bf10fb28a9b640"
+// a timelock of 16, which is OP_16
+#define VEC_TIMELOCK16_LEAFHASH        "4dd8284431b0c75d024b1fa84f86582f5a1a37e8da4f17f31ae192bd2e3c9f24"
+#define VEC_TIMELOCK16_CHANGE_OUTPUT_KEY "e7c55f2fb8f63f3a977128ba09fde76d481cf2cbfaab924d1ca3f61c64147ec9"
+// 16 covenant keys, key i being 32 bytes of value i, with a quorum of 16
+#define VEC_QUORUM16_UNBONDING_LEAFHASH "a5fc3376d16c44c8948cb89b6c9efdb47e2373b6cf5d6e0328b90037aa35e522"
+#define VEC_QUORUM16_STAKING_OUTPUT_KEY "e24f84ca0ccf90981e1d1ea96e4305cdd5d233b87ce0c5ef053b26977fd1d3df"
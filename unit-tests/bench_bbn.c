@@ -0,0 +1,279 @@
+/**
+ * Microbenchmarks of the Babylon core modules on the host.
+ *
+ * Every workload is fixed, so two runs of the same build hash and copy exactly the same bytes.
+ * One JSON object is printed per benchmark, with the fields name, iterations, ns_per_op,
+ * sha256_per_op (SHA-256 compressions) and bytes_copied_per_op (bytes moved with memcpy/memmove
+ * by the modules, not by the shim).
+ *
+ * Usage: bench_bbn [--quick]
+ */
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "bitcoin_app_base/src/handler/sign_psbt.h"
+#include "bbn_def.h"
+#include "bbn_data.h"
+#include "bbn_tlv.h"
+#include "bbn_script.h"
+#include "bbn_taptree.h"
+#include "bbn_address.h"
+#include "bbn_test.h"
+#include "bbn_vectors.h"
+
+#define BENCH_TLV_BUFFER_SIZE 1400
+#define BENCH_MESSAGE_LEN     256  // largest message accepted by the TLV parser
+
+typedef bool (*bench_fn_t)(void);
+
+static uint32_t g_iterations_scale = 1;
+
+static uint8_t g_tlv[BENCH_TLV_BUFFER_SIZE];
+static size_t g_tlv_len;
+static uint8_t g_message[BENCH_MESSAGE_LEN];
+static uint8_t g_xonly_key[32];
+static uint8_t g_compressed_key[33];
+static sign_psbt_state_t g_state;
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000ull + (uint64_t) ts.tv_nsec;
+}
+
+static void run_bench(const char *name, bench_fn_t fn, uint32_t iterations) {
+    iterations = iterations / g_iterations_scale;
+    if (iterations == 0) {
+        iterations = 1;
+    }
+
+    // warm-up, which also checks that the workload takes the success path
+    if (!fn()) {
+        fprintf(stderr, "%s: workload failed\n", name);
+        exit(1);
+    }
+
+    uint64_t hashes = g_shim_sha256_compressions;
+    uint64_t copied = g_shim_bytes_copied;
+    uint64_t start = now_ns();
+    for (uint32_t i = 0; i < iterations; i++) {
+        fn();
+    }
+    uint64_t elapsed = now_ns() - start;
+    hashes = g_shim_sha256_compressions - hashes;
+    copied = g_shim_bytes_copied - copied;
+
+    printf(
+        "{\"name\": \"%s\", \"iterations\": %u, \"ns_per_op\": %.1f, \"sha256_per_op\": %.2f, "
+        "\"bytes_copied_per_op\": %.1f}\n",
+        name,
+        iterations,
+        (double) elapsed / iterations,
+        (double) hashes / iterations,
+        (double) copied / iterations);
+}
+
+static size_t put_tlv(uint8_t *out, uint8_t tag, const uint8_t *value, uint16_t len) {
+    out[0] = tag;
+    out[1] = len >> 8;
+    out[2] = len & 0xff;
+    memcpy(out + 3, value, len);
+    return 3 + len;
+}
+
+// Deterministic keys: the signet vectors, then variations of them beyond the 9 covenant keys.
+static void bench_key(size_t index, uint8_t out[32]) {
+    hex_to_bytes(VEC_COV_PKS[index % VEC_COV_COUNT], out, 32);
+    out[31] ^= (uint8_t) (index / VEC_COV_COUNT);
+}
+
+/**
+ * Builds the TLV data of a staking delegation with the given number of FP and covenant keys, and
+ * optionally a message of BENCH_MESSAGE_LEN bytes.
+ */
+static void build_tlv(uint8_t fp_count, uint8_t cov_count, uint64_t timelock, bool with_message) {
+    uint8_t keys[MAX_COV_KEY_COUNT * 32];
+    uint8_t u64[8];
+    size_t len = 0;
+
+    len += put_tlv(g_tlv + len, TAG_ACTION_TYPE, (uint8_t[]){BBN_POLICY_STAKE_TRANSFER}, 1);
+    hex_to_bytes(VEC_STAKER_PK, keys, 32);
+    len += put_tlv(g_tlv + len, TAG_STAKER_PK, keys, 32);
+    len += put_tlv(g_tlv + len, TAG_FP_COUNT, &fp_count, 1);
+    hex_to_bytes(VEC_FP_PK, keys, 32);
+    for (size_t i = 1; i < fp_count; i++) {
+        bench_key(i + MAX_COV_KEY_COUNT, keys + 32 * i);
+    }
+    len += put_tlv(g_tlv + len, TAG_FP_LIST, keys, 32 * fp_count);
+    if (fp_count > 1) {
+        len += put_tlv(g_tlv + len, TAG_FP_QUORUM, (uint8_t[]){1}, 1);
+    }
+    len += put_tlv(g_tlv + len, TAG_COV_KEY_COUNT, &cov_count, 1);
+    for (size_t i = 0; i < cov_count; i++) {
+        bench_key(i, keys + 32 * i);
+    }
+    len += put_tlv(g_tlv + len, TAG_COV_KEY_LIST, keys, 32 * cov_count);
+    uint8_t quorum = cov_count < VEC_COV_QUORUM ? cov_count : VEC_COV_QUORUM;
+    len += put_tlv(g_tlv + len, TAG_COV_QUORUM, &quorum, 1);
+    for (int i = 0; i < 8; i++) {
+        u64[i] = timelock >> (56 - 8 * i);
+    }
+    len += put_tlv(g_tlv + len, TAG_TIMELOCK, u64, 8);
+    // 1000 sats for both fees
+    len += put_tlv(g_tlv + len, TAG_SLASHING_FEE_LIMIT, (uint8_t[]){0, 0, 0, 0, 0, 0, 3, 0xe8}, 8);
+    len += put_tlv(g_tlv + len, TAG_UNBONDING_FEE_LIMIT, (uint8_t[]){0, 0, 0, 0, 0, 0, 3, 0xe8}, 8);
+    len += put_tlv(g_tlv + len, TAG_BURN_ADDRESS, (uint8_t[]){0x6a, 0x20}, 2);
+    if (with_message) {
+        len += put_tlv(g_tlv + len, TAG_MESSAGE, g_message, sizeof(g_message));
+    }
+    g_tlv_len = len;
+}
+
+static void setup_params(uint8_t fp_count, uint8_t cov_count, uint64_t timelock) {
+    build_tlv(fp_count, cov_count, timelock, false);
+    if (!parse_tlv_data(g_tlv, g_tlv_len)) {
+        fprintf(stderr, "invalid benchmark TLV data\n");
+        exit(1);
+    }
+    bbn_taptree_invalidate();
+}
+
+// Sets output `index` of g_state to the P2TR script of the given taproot tree.
+static void setup_p2tr_output(size_t index, bbn_tree_t tree) {
+    g_state.outputs.output_scripts[index][0] = 0x51;
+    g_state.outputs.output_scripts[index][1] = 0x20;
+    bbn_taptree_output_key(tree, g_state.outputs.output_scripts[index] + 2);
+    g_state.outputs.output_script_lengths[index] = 34;
+    bbn_taptree_invalidate();
+}
+
+static bool bench_parse_tlv(void) {
+    return parse_tlv_data(g_tlv, g_tlv_len);
+}
+
+static bool bench_leafhash_slashing(void) {
+    uint8_t hash[32];
+    return compute_bbn_leafhash_slashing(hash);
+}
+
+static bool bench_leafhash_unbonding(void) {
+    uint8_t hash[32];
+    return compute_bbn_leafhash_unbonding(hash);
+}
+
+static bool bench_leafhash_timelock(void) {
+    uint8_t hash[32];
+    return compute_bbn_leafhash_timelock(hash);
+}
+
+// The trees are memoized per parameter set: every run below starts from a fresh set.
+static bool bench_merkle_root(void) {
+    uint8_t hash[32];
+    bbn_taptree_invalidate();
+    compute_bbn_merkle_root(hash);
+    return true;
+}
+
+static bool bench_check_staking_address(void) {
+    bbn_taptree_invalidate();
+    return bbn_check_staking_address(&g_state);
+}
+
+static bool bench_check_slashing_address(void) {
+    bbn_taptree_invalidate();
+    return bbn_check_slashing_address(&g_state);
+}
+
+static bool bench_check_unbond_address(void) {
+    bbn_taptree_invalidate();
+    return bbn_check_unbond_address(&g_state);
+}
+
+static bool bench_bip322_taproot(void) {
+    uint8_t txid[32];
+    compute_bip322_txid_by_message(g_message, sizeof(g_message), g_xonly_key, txid);
+    return true;
+}
+
+static bool bench_bip322_p2wpkh(void) {
+    uint8_t txid[32];
+    compute_bip322_txid_by_message_p2wpkh(g_message, sizeof(g_message), g_compressed_key, txid);
+    return true;
+}
+
+static void bench_tlv_shapes(void) {
+    static const uint8_t shapes[][2] = {{1, 1}, {1, 9}, {4, 9}, {16, 16}};
+    char name[64];
+
+    for (size_t i = 0; i < sizeof(shapes) / sizeof(shapes[0]); i++) {
+        build_tlv(shapes[i][0], shapes[i][1], VEC_STAKING_TIMELOCK, false);
+        snprintf(name, sizeof(name), "parse_tlv_data/fp%u_cov%u", shapes[i][0], shapes[i][1]);
+        run_bench(name, bench_parse_tlv, 200000);
+    }
+    build_tlv(1, 9, VEC_STAKING_TIMELOCK, true);
+    run_bench("parse_tlv_data/fp1_cov9_msg256", bench_parse_tlv, 200000);
+}
+
+static void bench_scripts(void) {
+    static const uint8_t shapes[][2] = {{1, 9}, {16, 16}};
+    char name[64];
+
+    for (size_t i = 0; i < sizeof(shapes) / sizeof(shapes[0]); i++) {
+        setup_params(shapes[i][0], shapes[i][1], VEC_STAKING_TIMELOCK);
+        snprintf(name, sizeof(name), "leafhash_slashing/fp%u_cov%u", shapes[i][0], shapes[i][1]);
+        run_bench(name, bench_leafhash_slashing, 100000);
+        snprintf(name, sizeof(name), "leafhash_unbonding/cov%u", shapes[i][1]);
+        run_bench(name, bench_leafhash_unbonding, 100000);
+        snprintf(name, sizeof(name), "merkle_root/fp%u_cov%u", shapes[i][0], shapes[i][1]);
+        run_bench(name, bench_merkle_root, 50000);
+    }
+    run_bench("leafhash_timelock", bench_leafhash_timelock, 200000);
+}
+
+static void bench_addresses(void) {
+    memset(&g_state, 0, sizeof(g_state));
+
+    setup_params(1, VEC_COV_COUNT, VEC_STAKING_TIMELOCK);
+    setup_p2tr_output(0, BBN_TREE_STAKING);
+    run_bench("check_staking_address", bench_check_staking_address, 2000);
+
+    // slashing: burn output first, then the change back to the staker; fee at the limit
+    setup_params(1, VEC_COV_COUNT, VEC_TIMELOCK);
+    g_state.outputs.output_scripts[0][0] = 0x6a;
+    g_state.outputs.output_scripts[0][1] = 0x20;
+    g_state.outputs.output_script_lengths[0] = 34;
+    setup_p2tr_output(1, BBN_TREE_TIMELOCK);
+    g_state.inputs_total_amount = 50000;
+    g_state.outputs.total_amount = 49000;
+    run_bench("check_slashing_address", bench_check_slashing_address, 2000);
+
+    setup_p2tr_output(0, BBN_TREE_UNBONDING);
+    run_bench("check_unbond_address", bench_check_unbond_address, 2000);
+}
+
+static void bench_bip322(void) {
+    hex_to_bytes(VEC_STAKER_PK, g_xonly_key, 32);
+    g_compressed_key[0] = 0x02;
+    memcpy(g_compressed_key + 1, g_xonly_key, 32);
+
+    run_bench("bip322_txid_taproot/msg256", bench_bip322_taproot, 100000);
+    run_bench("bip322_txid_p2wpkh/msg256", bench_bip322_p2wpkh, 100000);
+}
+
+int main(int argc, char **argv) {
+    if (argc > 1 && strcmp(argv[1], "--quick") == 0) {
+        g_iterations_scale = 1000;
+    }
+
+    for (size_t i = 0; i < sizeof(g_message); i++) {
+        g_message[i] = 'a' + i % 26;
+    }
+
+    bench_tlv_shapes();
+    bench_scripts();
+    bench_addresses();
+    bench_bip322();
+    return 0;
+}
@@ -0,0 +1,9 @@
+#!/bin/bash
+# Builds the Babylon core modules for the host, and runs the unit tests.
+set -e
+
+cd "$(dirname "$0")"
+
+cmake -S . -B build -DCMAKE_BUILD_TYPE=Debug
+cmake --build build -j"$(nproc)"
+ctest --test-dir build --output-on-failure
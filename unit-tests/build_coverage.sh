@@ -0,0 +1,13 @@
+#!/bin/bash
+# Runs the unit tests with coverage instrumentation, and writes build_coverage/coverage.info.
+set -e
+
+cd "$(dirname "$0")"
+
+cmake -S . -B build_coverage -DCMAKE_BUILD_TYPE=Debug -DBBN_COVERAGE=ON
+cmake --build build_coverage -j"$(nproc)"
+ctest --test-dir build_coverage --output-on-failure
+
+lcov --capture --directory build_coverage --output-file build_coverage/coverage.info
+lcov --extract build_coverage/coverage.info '*/stage/src/*' --output-file build_coverage/coverage.info
+lcov --list build_coverage/coverage.info
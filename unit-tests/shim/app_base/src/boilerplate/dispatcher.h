@@ -0,0 +1,46 @@
+#pragma once
+
+#include "../../../sdk_shim.h"
+
+// The host build never talks to a client; only the opaque type is needed.
+typedef struct dispatcher_context_s dispatcher_context_t;
+
+typedef struct {
+    const uint8_t *ptr;
+    size_t size;
+    size_t offset;
+} buffer_t;
+
+static inline bool buffer_can_read(const buffer_t *buffer, size_t n) {
+    return buffer->size - buffer->offset >= n;
+}
+
+static inline bool buffer_read_bytes(buffer_t *buffer, uint8_t *out, size_t n) {
+    if (!buffer_can_read(buffer, n)) {
+        return false;
+    }
+    memcpy(out, buffer->ptr + buffer->offset, n);
+    buffer->offset += n;
+    return true;
+}
+
+static inline bool buffer_read_varint(buffer_t *buffer, uint64_t *value) {
+    uint8_t prefix;
+    if (!buffer_read_bytes(buffer, &prefix, 1)) {
+        return false;
+    }
+    size_t n = prefix < 0xfd ? 0 : prefix == 0xfd ? 2 : prefix == 0xfe ? 4 : 8;
+    if (n == 0) {
+        *value = prefix;
+        return true;
+    }
+    uint8_t raw[8];
+    if (!buffer_read_bytes(buffer, raw, n)) {
+        return false;
+    }
+    *value = 0;
+    for (size_t i = 0; i < n; i++) {
+        *value |= (uint64_t) raw[i] << (8 * i);
+    }
+    return true;
+}
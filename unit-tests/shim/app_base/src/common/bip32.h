@@ -0,0 +1,3 @@
+#pragma once
+
+#define BIP32_FIRST_HARDENED_CHILD 0x80000000u
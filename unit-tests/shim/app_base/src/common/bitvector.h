@@ -0,0 +1,17 @@
+#pragma once
+
+#include <stdint.h>
+
+#define BITVECTOR_REAL_SIZE(n) (((n) + 7) / 8)
+
+static inline int bitvector_get(const uint8_t *bv, unsigned int i) {
+    return (bv[i / 8] >> (i % 8)) & 1;
+}
+
+static inline void bitvector_set(uint8_t *bv, unsigned int i, int value) {
+    if (value) {
+        bv[i / 8] |= 1 << (i % 8);
+    } else {
+        bv[i / 8] &= ~(1 << (i % 8));
+    }
+}
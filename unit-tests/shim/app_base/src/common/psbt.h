@@ -0,0 +1,8 @@
+#pragma once
+
+#define PSBT_IN_NON_WITNESS_UTXO 0x00
+#define PSBT_IN_WITNESS_UTXO     0x01
+#define PSBT_IN_TAP_LEAF_SCRIPT  0x15
+#define PSBT_IN_PREVIOUS_TXID    0x0e
+#define PSBT_OUT_AMOUNT          0x03
+#define PSBT_OUT_SCRIPT          0x04
@@ -0,0 +1,13 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+static inline uint32_t read_u32_be(const uint8_t *ptr, size_t offset) {
+    return (uint32_t) ptr[offset + 0] << 24 | (uint32_t) ptr[offset + 1] << 16 |
+           (uint32_t) ptr[offset + 2] << 8 | (uint32_t) ptr[offset + 3];
+}
+
+static inline uint64_t read_u64_be(const uint8_t *ptr, size_t offset) {
+    return (uint64_t) read_u32_be(ptr, offset) << 32 | read_u32_be(ptr, offset + 4);
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include "../../sdk_shim.h"
+
+typedef struct {
+    uint8_t version[4];
+    uint8_t depth;
+    uint8_t parent_fingerprint[4];
+    uint8_t child_number[4];
+    uint8_t chain_code[32];
+    uint8_t compressed_pubkey[33];
+} serialized_extended_pubkey_t;
+
+int crypto_hash_update(cx_hash_t *hash_context, const void *in, size_t in_len);
+int crypto_hash_digest(cx_hash_t *hash_context, uint8_t *out, size_t out_len);
+void crypto_hash_update_u8(cx_hash_t *hash_context, uint8_t data);
+void crypto_hash_update_u32(cx_hash_t *hash_context, uint32_t data);
+void crypto_hash_update_varint(cx_hash_t *hash_context, uint64_t data);
+
+void crypto_hash160(const uint8_t *in, uint16_t inlen, uint8_t *out);
+
+void crypto_tr_tagged_hash_init(cx_sha256_t *hash_context, const uint8_t *tag, uint16_t tag_len);
+void crypto_tr_tapleaf_hash_init(cx_sha256_t *hash_context);
+void crypto_tr_combine_taptree_hashes(const uint8_t left_h[static 32],
+                                      const uint8_t right_h[static 32],
+                                      uint8_t out[static 32]);
+int crypto_tr_tweak_pubkey(const uint8_t pubkey[static 32],
+                           const uint8_t *h,
+                           size_t h_len,
+                           uint8_t *y_parity,
+                           uint8_t out[static 32]);
+
+int crypto_tr_tweak_seckey(const uint8_t seckey[static 32],
+                           const uint8_t *h,
+                           size_t h_len,
+                           uint8_t out[static 32]);
+
+int get_extended_pubkey_at_path(const uint32_t bip32_path[],
+                                uint8_t bip32_path_len,
+                                uint32_t bip32_pubkey_version,
+                                serialized_extended_pubkey_t *out_pubkey);
@@ -0,0 +1,17 @@
+#pragma once
+
+#include <stdint.h>
+
+typedef struct {
+    uint64_t size;
+    uint8_t keys_root[32];
+    uint8_t values_root[32];
+} merkleized_map_commitment_t;
+
+#include "../../boilerplate/dispatcher.h"
+
+int call_get_merkleized_map(dispatcher_context_t *dc,
+                            const uint8_t root[static 32],
+                            int size,
+                            int index,
+                            merkleized_map_commitment_t *out_ptr);
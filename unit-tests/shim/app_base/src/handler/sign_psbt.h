@@ -0,0 +1,31 @@
+#pragma once
+
+#include <stdint.h>
+#include "../crypto.h"
+#include "../common/bitvector.h"
+#include "../boilerplate/dispatcher.h"
+#include "lib/get_merkleized_map.h"
+
+#define MAX_N_INPUTS_CAN_SIGN       512
+#define MAX_N_OUTPUTS_CAN_SIGN      512
+#define N_CACHED_EXTERNAL_OUTPUTS   4
+#define MAX_OUTPUT_SCRIPTPUBKEY_LEN 83
+
+#define OP_RETURN 0x6a
+
+typedef struct {
+    uint64_t total_amount;
+    uint64_t output_amounts[N_CACHED_EXTERNAL_OUTPUTS];
+    uint8_t output_scripts[N_CACHED_EXTERNAL_OUTPUTS][MAX_OUTPUT_SCRIPTPUBKEY_LEN];
+    size_t output_script_lengths[N_CACHED_EXTERNAL_OUTPUTS];
+} bbn_shim_outputs_t;
+
+typedef struct {
+    uint32_t n_inputs;
+    uint8_t inputs_root[32];
+    uint32_t n_outputs;
+    uint8_t outputs_root[32];
+    uint64_t inputs_total_amount;
+    bbn_shim_outputs_t outputs;
+    int protocol_version;
+} sign_psbt_state_t;
@@ -0,0 +1,13 @@
+/**
+ * Clock of the trace on the host: microseconds of a monotonic clock, wrapping like a device tick
+ * counter.
+ */
+#include <time.h>
+#include "sdk_shim.h"
+
+uint32_t shim_clock_us(void) {
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint32_t) ((uint64_t) now.tv_sec * 1000000 + (uint64_t) now.tv_nsec / 1000);
+}
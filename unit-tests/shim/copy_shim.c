@@ -0,0 +1,16 @@
+/**
+ * Counted memcpy/memmove, substituted for the real ones in the Babylon modules.
+ */
+#include "sdk_shim.h"
+
+uint64_t g_shim_bytes_copied;
+
+void *shim_memcpy(void *dst, const void *src, size_t len) {
+    g_shim_bytes_copied += len;
+    return memcpy(dst, src, len);
+}
+
+void *shim_memmove(void *dst, const void *src, size_t len) {
+    g_shim_bytes_copied += len;
+    return memmove(dst, src, len);
+}
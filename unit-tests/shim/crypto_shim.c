@@ -0,0 +1,385 @@
+/**
+ * Host implementation of the helpers of the Bitcoin app (crypto.h and merkle.h) that the Babylon
+ * modules rely on, on top of the portable SHA-256 and secp256k1 shims.
+ */
+#include "sdk_shim.h"
+#include "secp256k1_shim.h"
+#include "lib_standard_app/crypto_helpers.h"
+#include "bitcoin_app_base/src/crypto.h"
+#include "bitcoin_app_base/src/common/merkle.h"
+
+int crypto_hash_update(cx_hash_t *hash_context, const void *in, size_t in_len) {
+    return shim_sha256_update((cx_sha256_t *) hash_context, in, in_len);
+}
+
+int crypto_hash_digest(cx_hash_t *hash_context, uint8_t *out, size_t out_len) {
+    if (out_len < 32) {
+        return -1;
+    }
+    return shim_sha256_final((cx_sha256_t *) hash_context, out);
+}
+
+void crypto_hash_update_u8(cx_hash_t *hash_context, uint8_t data) {
+    crypto_hash_update(hash_context, &data, 1);
+}
+
+void crypto_hash_update_u32(cx_hash_t *hash_context, uint32_t data) {
+    uint8_t buf[4] = {data >> 24, data >> 16, data >> 8, data};
+    crypto_hash_update(hash_context, buf, sizeof(buf));
+}
+
+void crypto_hash_update_varint(cx_hash_t *hash_context, uint64_t data) {
+    uint8_t buf[9];
+    size_t len;
+    if (data < 0xFD) {
+        buf[0] = (uint8_t) data;
+        len = 1;
+    } else if (data <= 0xFFFF) {
+        buf[0] = 0xFD;
+        buf[1] = (uint8_t) data;
+        buf[2] = (uint8_t) (data >> 8);
+        len = 3;
+    } else if (data <= 0xFFFFFFFF) {
+        buf[0] = 0xFE;
+        for (int i = 0; i < 4; i++) {
+            buf[1 + i] = (uint8_t) (data >> (8 * i));
+        }
+        len = 5;
+    } else {
+        buf[0] = 0xFF;
+        for (int i = 0; i < 8; i++) {
+            buf[1 + i] = (uint8_t) (data >> (8 * i));
+        }
+        len = 9;
+    }
+    crypto_hash_update(hash_context, buf, len);
+}
+
+static void sha256(const uint8_t *in, size_t len, uint8_t out[32]) {
+    cx_sha256_t ctx;
+    cx_sha256_init(&ctx);
+    shim_sha256_update(&ctx, in, len);
+    shim_sha256_final(&ctx, out);
+}
+
+void merkle_compute_element_hash(const uint8_t *in, size_t in_len, uint8_t out[static 32]) {
+    cx_sha256_t ctx;
+    cx_sha256_init(&ctx);
+    crypto_hash_update_u8(&ctx.header, 0x00);
+    crypto_hash_update(&ctx.header, in, in_len);
+    crypto_hash_digest(&ctx.header, out, 32);
+}
+
+void merkle_combine_hashes(const uint8_t left[static 32],
+                           const uint8_t right[static 32],
+                           uint8_t out[static 32]) {
+    cx_sha256_t ctx;
+    cx_sha256_init(&ctx);
+    crypto_hash_update_u8(&ctx.header, 0x01);
+    crypto_hash_update(&ctx.header, left, 32);
+    crypto_hash_update(&ctx.header, right, 32);
+    crypto_hash_digest(&ctx.header, out, 32);
+}
+
+void crypto_tr_tagged_hash_init(cx_sha256_t *hash_context, const uint8_t *tag, uint16_t tag_len) {
+    uint8_t hashtag[32];
+    sha256(tag, tag_len, hashtag);
+    cx_sha256_init(hash_context);
+    crypto_hash_update(&hash_context->header, hashtag, 32);
+    crypto_hash_update(&hash_context->header, hashtag, 32);
+}
+
+static const uint8_t BIP0341_tapleaf_tag[] = {'T', 'a', 'p', 'L', 'e', 'a', 'f'};
+static const uint8_t BIP0341_tapbranch_tag[] = {'T', 'a', 'p', 'B', 'r', 'a', 'n', 'c', 'h'};
+static const uint8_t BIP0341_taptweak_tag[] = {'T', 'a', 'p', 'T', 'w', 'e', 'a', 'k'};
+
+void crypto_tr_tapleaf_hash_init(cx_sha256_t *hash_context) {
+    crypto_tr_tagged_hash_init(hash_context, BIP0341_tapleaf_tag, sizeof(BIP0341_tapleaf_tag));
+}
+
+void crypto_tr_combine_taptree_hashes(const uint8_t left_h[static 32],
+                                      const uint8_t right_h[static 32],
+                                      uint8_t out[static 32]) {
+    if (memcmp(right_h, left_h, 32) < 0) {
+        const uint8_t *tmp = left_h;
+        left_h = right_h;
+        right_h = tmp;
+    }
+    cx_sha256_t ctx;
+    crypto_tr_tagged_hash_init(&ctx, BIP0341_tapbranch_tag, sizeof(BIP0341_tapbranch_tag));
+    crypto_hash_update(&ctx.header, left_h, 32);
+    crypto_hash_update(&ctx.header, right_h, 32);
+    crypto_hash_digest(&ctx.header, out, 32);
+}
+
+int crypto_tr_tweak_pubkey(const uint8_t pubkey[static 32],
+                           const uint8_t *h,
+                           size_t h_len,
+                           uint8_t *y_parity,
+                           uint8_t out[static 32]) {
+    uint8_t t[32];
+    cx_sha256_t ctx;
+    crypto_tr_tagged_hash_init(&ctx, BIP0341_taptweak_tag, sizeof(BIP0341_taptweak_tag));
+    crypto_hash_update(&ctx.header, pubkey, 32);
+    crypto_hash_update(&ctx.header, h, h_len);
+    crypto_hash_digest(&ctx.header, t, 32);
+
+    fe_t x, k;
+    point_t p, tg, q;
+    fe_from_bytes(&x, pubkey);
+    fe_from_bytes(&k, t);
+    if (!secp_lift_x(&p, &x) || !secp_scalar_is_valid(&k)) {
+        return -1;
+    }
+    if (!secp_mul_g(&tg, &k) || !secp_add(&q, &tg, &p)) {
+        return -1;
+    }
+    fe_to_bytes(out, &q.x);
+    if (y_parity != NULL) {
+        *y_parity = q.y.v[0] & 1;
+    }
+    return 0;
+}
+
+int crypto_tr_tweak_seckey(const uint8_t seckey[static 32],
+                           const uint8_t *h,
+                           size_t h_len,
+                           uint8_t out[static 32]) {
+    fe_t d, t;
+    point_t p;
+    uint8_t pubkey[32];
+    uint8_t tweak[32];
+
+    fe_from_bytes(&d, seckey);
+    if (!secp_scalar_is_valid(&d) || !secp_mul_g(&p, &d)) {
+        return -1;
+    }
+    // the x-only internal key stands for the point with an even y
+    if (p.y.v[0] & 1) {
+        secp_scalar_negate(&d, &d);
+    }
+    fe_to_bytes(pubkey, &p.x);
+
+    cx_sha256_t ctx;
+    crypto_tr_tagged_hash_init(&ctx, BIP0341_taptweak_tag, sizeof(BIP0341_taptweak_tag));
+    crypto_hash_update(&ctx.header, pubkey, 32);
+    crypto_hash_update(&ctx.header, h, h_len);
+    crypto_hash_digest(&ctx.header, tweak, 32);
+    fe_from_bytes(&t, tweak);
+    if (!secp_scalar_is_valid(&t)) {
+        return -1;
+    }
+    secp_scalar_add(&d, &d, &t);
+    fe_to_bytes(out, &d);
+    return 0;
+}
+
+cx_err_t bip32_derive_init_privkey_256(cx_curve_t curve,
+                                       const uint32_t *path,
+                                       size_t path_len,
+                                       cx_ecfp_private_key_t *privkey,
+                                       uint8_t *chain_code) {
+    UNUSED(chain_code);
+    privkey->curve = curve;
+    privkey->d_len = 32;
+    shim_derive_privkey(path, path_len, privkey->d);
+    return CX_OK;
+}
+
+cx_err_t cx_ecfp_generate_pair_no_throw(cx_curve_t curve,
+                                        cx_ecfp_public_key_t *pubkey,
+                                        cx_ecfp_private_key_t *privkey,
+                                        bool keepprivate) {
+    UNUSED(keepprivate);
+    fe_t k;
+    point_t p;
+    fe_from_bytes(&k, privkey->d);
+    if (!secp_scalar_is_valid(&k) || !secp_mul_g(&p, &k)) {
+        return 0xFFFFFFFF;
+    }
+    pubkey->curve = curve;
+    pubkey->W_len = 65;
+    pubkey->W[0] = 0x04;
+    fe_to_bytes(pubkey->W + 1, &p.x);
+    fe_to_bytes(pubkey->W + 33, &p.y);
+    return CX_OK;
+}
+
+static void point_from_bytes(point_t *r, const uint8_t in[65]) {
+    fe_from_bytes(&r->x, in + 1);
+    fe_from_bytes(&r->y, in + 33);
+}
+
+static void point_to_bytes(uint8_t out[65], const point_t *p) {
+    out[0] = 0x04;
+    fe_to_bytes(out + 1, &p->x);
+    fe_to_bytes(out + 33, &p->y);
+}
+
+cx_err_t cx_ecfp_scalar_mult_no_throw(cx_curve_t curve, uint8_t *P, const uint8_t *k, size_t k_len) {
+    UNUSED(curve);
+    fe_t scalar;
+    point_t p;
+    if (k_len != 32) {
+        return 0xFFFFFFFF;
+    }
+    fe_from_bytes(&scalar, k);
+    point_from_bytes(&p, P);
+    if (!secp_scalar_is_valid(&scalar) || !secp_mul_add(&p, &scalar, &p, NULL)) {
+        return 0xFFFFFFFF;
+    }
+    point_to_bytes(P, &p);
+    return CX_OK;
+}
+
+cx_err_t cx_ecfp_add_point_no_throw(cx_curve_t curve,
+                                    uint8_t *R,
+                                    const uint8_t *P,
+                                    const uint8_t *Q) {
+    UNUSED(curve);
+    point_t p, q, r;
+    point_from_bytes(&p, P);
+    point_from_bytes(&q, Q);
+    if (!secp_add(&r, &p, &q)) {
+        return 0xFFFFFFFF;
+    }
+    point_to_bytes(R, &r);
+    return CX_OK;
+}
+
+/* RIPEMD-160, only used by crypto_hash160 */
+
+#define ROL(x, n) (((x) << (n)) | ((x) >> (32 - (n))))
+
+static uint32_t rmd_f(int j, uint32_t x, uint32_t y, uint32_t z) {
+    if (j < 16) return x ^ y ^ z;
+    if (j < 32) return (x & y) | (~x & z);
+    if (j < 48) return (x | ~y) ^ z;
+    if (j < 64) return (x & z) | (y & ~z);
+    return x ^ (y | ~z);
+}
+
+static void ripemd160(const uint8_t *in, size_t len, uint8_t out[20]) {
+    static const uint8_t r[80] = {0,  1,  2,  3,  4,  5,  6,  7,  8,  9,  10, 11, 12, 13, 14, 15,
+                                  7,  4,  13, 1,  10, 6,  15, 3,  12, 0,  9,  5,  2,  14, 11, 8,
+                                  3,  10, 14, 4,  9,  15, 8,  1,  2,  7,  0,  6,  13, 11, 5,  12,
+                                  1,  9,  11, 10, 0,  8,  12, 4,  13, 3,  7,  15, 14, 5,  6,  2,
+                                  4,  0,  5,  9,  7,  12, 2,  10, 14, 1,  3,  8,  11, 6,  15, 13};
+    static const uint8_t rp[80] = {5,  14, 7,  0,  9, 2,  11, 4,  13, 6,  15, 8,  1,  10, 3,  12,
+                                   6,  11, 3,  7,  0, 13, 5,  10, 14, 15, 8,  12, 4,  9,  1,  2,
+                                   15, 5,  1,  3,  7, 14, 6,  9,  11, 8,  12, 2,  10, 0,  4,  13,
+                                   8,  6,  4,  1,  3, 11, 15, 0,  5,  12, 2,  13, 9,  7,  10, 14,
+                                   12, 15, 10, 4,  1, 5,  8,  7,  6,  2,  13, 14, 0,  3,  9,  11};
+    static const uint8_t s[80] = {11, 14, 15, 12, 5,  8,  7,  9,  11, 13, 14, 15, 6,  7,  9,  8,
+                                  7,  6,  8,  13, 11, 9,  7,  15, 7,  12, 15, 9,  11, 7,  13, 12,
+                                  11, 13, 6,  7,  14, 9,  13, 15, 14, 8,  13, 6,  5,  12, 7,  5,
+                                  11, 12, 14, 15, 14, 15, 9,  8,  9,  14, 5,  6,  8,  6,  5,  12,
+                                  9,  15, 5,  11, 6,  8,  13, 12, 5,  12, 13, 14, 11, 8,  5,  6};
+    static const uint8_t sp[80] = {8,  9,  9,  11, 13, 15, 15, 5,  7,  7,  8,  11, 14, 14, 12, 6,
+                                   9,  13, 15, 7,  12, 8,  9,  11, 7,  7,  12, 7,  6,  15, 13, 11,
+                                   9,  7,  15, 11, 8,  6,  6,  14, 12, 13, 5,  14, 13, 13, 7,  5,
+                                   15, 5,  8,  11, 14, 14, 6,  14, 6,  9,  12, 9,  12, 5,  15, 8,
+                                   8,  5,  12, 9,  12, 5,  14, 6,  8,  13, 6,  5,  15, 13, 11, 11};
+    static const uint32_t k[5] = {0x00000000, 0x5A827999, 0x6ED9EBA1, 0x8F1BBCDC, 0xA953FD4E};
+    static const uint32_t kp[5] = {0x50A28BE6, 0x5C4DD124, 0x6D703EF3, 0x7A6D76E9, 0x00000000};
+
+    uint32_t h[5] = {0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476, 0xC3D2E1F0};
+    size_t n_blocks = (len + 9 + 63) / 64;
+    for (size_t b = 0; b < n_blocks; b++) {
+        uint8_t block[64];
+        for (size_t i = 0; i < 64; i++) {
+            size_t pos = b * 64 + i;
+            if (pos < len) {
+                block[i] = in[pos];
+            } else if (pos == len) {
+                block[i] = 0x80;
+            } else {
+                block[i] = 0;
+            }
+        }
+        if (b == n_blocks - 1) {
+            uint64_t bitlen = (uint64_t) len * 8;
+            for (int i = 0; i < 8; i++) {
+                block[56 + i] = (uint8_t) (bitlen >> (8 * i));
+            }
+        }
+        uint32_t x[16];
+        for (int i = 0; i < 16; i++) {
+            x[i] = (uint32_t) block[4 * i] | (uint32_t) block[4 * i + 1] << 8 |
+                   (uint32_t) block[4 * i + 2] << 16 | (uint32_t) block[4 * i + 3] << 24;
+        }
+        uint32_t al = h[0], bl = h[1], cl = h[2], dl = h[3], el = h[4];
+        uint32_t ar = h[0], br = h[1], cr = h[2], dr = h[3], er = h[4];
+        for (int j = 0; j < 80; j++) {
+            uint32_t t = ROL(al + rmd_f(j, bl, cl, dl) + x[r[j]] + k[j / 16], s[j]) + el;
+            al = el;
+            el = dl;
+            dl = ROL(cl, 10);
+            cl = bl;
+            bl = t;
+            t = ROL(ar + rmd_f(79 - j, br, cr, dr) + x[rp[j]] + kp[j / 16], sp[j]) + er;
+            ar = er;
+            er = dr;
+            dr = ROL(cr, 10);
+            cr = br;
+            br = t;
+        }
+        uint32_t t = h[1] + cl + dr;
+        h[1] = h[2] + dl + er;
+        h[2] = h[3] + el + ar;
+        h[3] = h[4] + al + br;
+        h[4] = h[0] + bl + cr;
+        h[0] = t;
+    }
+    for (int i = 0; i < 5; i++) {
+        for (int j = 0; j < 4; j++) {
+            out[4 * i + j] = (uint8_t) (h[i] >> (8 * j));
+        }
+    }
+}
+
+void crypto_hash160(const uint8_t *in, uint16_t inlen, uint8_t *out) {
+    uint8_t h[32];
+    sha256(in, inlen, h);
+    ripemd160(h, 32, out);
+}
+
+/**
+ * Stand-in for the BIP32 derivation of the device: the private key is a hash of the path, so that
+ * keys are stable across runs but unrelated to any real seed.
+ */
+void shim_derive_privkey(const uint32_t bip32_path[], uint8_t bip32_path_len, uint8_t out[32]) {
+    cx_sha256_t ctx;
+    cx_sha256_init(&ctx);
+    shim_sha256_update(&ctx, (const uint8_t *) "bbn-host-shim", 13);
+    for (uint8_t i = 0; i < bip32_path_len; i++) {
+        uint32_t index = bip32_path[i];
+        uint8_t b[4] = {index >> 24, index >> 16, index >> 8, index};
+        shim_sha256_update(&ctx, b, 4);
+    }
+    shim_sha256_final(&ctx, out);
+}
+
+int get_extended_pubkey_at_path(const uint32_t bip32_path[],
+                                uint8_t bip32_path_len,
+                                uint32_t bip32_pubkey_version,
+                                serialized_extended_pubkey_t *out_pubkey) {
+    uint8_t seckey[32];
+    fe_t k;
+    point_t pub;
+
+    memset(out_pubkey, 0, sizeof(serialized_extended_pubkey_t));
+    for (int i = 0; i < 4; i++) {
+        out_pubkey->version[i] = (uint8_t) (bip32_pubkey_version >> (24 - 8 * i));
+    }
+    out_pubkey->depth = bip32_path_len;
+
+    shim_derive_privkey(bip32_path, bip32_path_len, seckey);
+    fe_from_bytes(&k, seckey);
+    if (!secp_scalar_is_valid(&k) || !secp_mul_g(&pub, &k)) {
+        return -1;
+    }
+    out_pubkey->compressed_pubkey[0] = 0x02 | (pub.y.v[0] & 1);
+    fe_to_bytes(out_pubkey->compressed_pubkey + 1, &pub.x);
+    return 0;
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include "../sdk_shim.h"
+
+#define CX_CURVE_256K1 0x21
+
+typedef uint32_t cx_curve_t;
+
+typedef struct {
+    cx_curve_t curve;
+    size_t d_len;
+    uint8_t d[32];
+} cx_ecfp_private_key_t;
+
+typedef struct {
+    cx_curve_t curve;
+    size_t W_len;
+    uint8_t W[65];
+} cx_ecfp_public_key_t;
+
+cx_err_t bip32_derive_init_privkey_256(cx_curve_t curve,
+                                       const uint32_t *path,
+                                       size_t path_len,
+                                       cx_ecfp_private_key_t *privkey,
+                                       uint8_t *chain_code);
+cx_err_t cx_ecfp_generate_pair_no_throw(cx_curve_t curve,
+                                        cx_ecfp_public_key_t *pubkey,
+                                        cx_ecfp_private_key_t *privkey,
+                                        bool keepprivate);
+// points are uncompressed, 0x04 || x || y
+cx_err_t cx_ecfp_scalar_mult_no_throw(cx_curve_t curve, uint8_t *P, const uint8_t *k, size_t k_len);
+cx_err_t cx_ecfp_add_point_no_throw(cx_curve_t curve,
+                                    uint8_t *R,
+                                    const uint8_t *P,
+                                    const uint8_t *Q);
@@ -0,0 +1,60 @@
+/**
+ * Host replacement for the subset of the Ledger SDK used by the Babylon core modules.
+ */
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <string.h>
+#include <stdio.h>
+
+#ifdef BBN_HOST_VERBOSE
+#define PRINTF(...) printf(__VA_ARGS__)
+#else
+#define PRINTF(...) \
+    do {            \
+    } while (0)
+#endif
+
+#define UNUSED(x) (void) (x)
+
+#define CX_OK 0x00000000
+
+typedef uint32_t cx_err_t;
+
+typedef struct {
+    uint32_t counter;  // number of 64-byte blocks compressed so far
+} cx_hash_header_t;
+
+typedef cx_hash_header_t cx_hash_t;
+
+typedef struct {
+    cx_hash_header_t header;
+    size_t blen;
+    uint8_t block[64];
+    uint8_t acc[32];
+} cx_sha256_t;
+
+int cx_sha256_init(cx_sha256_t *hash);
+
+// number of SHA-256 compressions performed since start; used by the benchmarks
+extern uint64_t g_shim_sha256_compressions;
+
+int shim_sha256_update(cx_sha256_t *hash, const uint8_t *in, size_t len);
+int shim_sha256_final(cx_sha256_t *hash, uint8_t out[32]);
+// bytes moved by memcpy/memmove in the Babylon modules since start; used by the benchmarks
+extern uint64_t g_shim_bytes_copied;
+
+void *shim_memcpy(void *dst, const void *src, size_t len);
+void *shim_memmove(void *dst, const void *src, size_t len);
+
+// clock of the trace (BBN_TRACE_CLOCK), in microseconds
+uint32_t shim_clock_us(void);
+
+#ifdef BBN_SHIM_COUNT_COPIES
+#define memcpy  shim_memcpy
+#define memmove shim_memmove
+#endif
+
+void shim_derive_privkey(const uint32_t bip32_path[], uint8_t bip32_path_len, uint8_t out[32]);
@@ -0,0 +1,309 @@
+/**
+ * Minimal, portable secp256k1 arithmetic for the host build: just enough to lift x-only keys,
+ * multiply the generator and add points. It is neither constant-time nor fast, and must never be
+ * used outside of tests and benchmarks.
+ */
+#include "sdk_shim.h"
+#include "secp256k1_shim.h"
+
+typedef unsigned __int128 u128;
+
+static const fe_t P = {{0xFFFFFFFEFFFFFC2Full,
+                        0xFFFFFFFFFFFFFFFFull,
+                        0xFFFFFFFFFFFFFFFFull,
+                        0xFFFFFFFFFFFFFFFFull}};
+static const fe_t N = {{0xBFD25E8CD0364141ull,
+                        0xBAAEDCE6AF48A03Bull,
+                        0xFFFFFFFFFFFFFFFEull,
+                        0xFFFFFFFFFFFFFFFFull}};
+static const fe_t GX = {{0x59F2815B16F81798ull,
+                         0x029BFCDB2DCE28D9ull,
+                         0x55A06295CE870B07ull,
+                         0x79BE667EF9DCBBACull}};
+static const fe_t GY = {{0x9C47D08FFB10D4B8ull,
+                         0xFD17B448A6855419ull,
+                         0x5DA4FBFC0E1108A8ull,
+                         0x483ADA7726A3C465ull}};
+
+void fe_from_bytes(fe_t *r, const uint8_t in[32]) {
+    for (int i = 0; i < 4; i++) {
+        uint64_t v = 0;
+        for (int j = 0; j < 8; j++) {
+            v = (v << 8) | in[(3 - i) * 8 + j];
+        }
+        r->v[i] = v;
+    }
+}
+
+void fe_to_bytes(uint8_t out[32], const fe_t *a) {
+    for (int i = 0; i < 4; i++) {
+        for (int j = 0; j < 8; j++) {
+            out[(3 - i) * 8 + j] = (uint8_t) (a->v[i] >> (56 - 8 * j));
+        }
+    }
+}
+
+static int fe_cmp(const fe_t *a, const fe_t *b) {
+    for (int i = 3; i >= 0; i--) {
+        if (a->v[i] != b->v[i]) {
+            return a->v[i] < b->v[i] ? -1 : 1;
+        }
+    }
+    return 0;
+}
+
+static bool fe_is_zero(const fe_t *a) {
+    return (a->v[0] | a->v[1] | a->v[2] | a->v[3]) == 0;
+}
+
+// r = a - b over 256 bits, returns the borrow
+static uint64_t raw_sub(fe_t *r, const fe_t *a, const fe_t *b) {
+    uint64_t borrow = 0;
+    for (int i = 0; i < 4; i++) {
+        u128 t = (u128) a->v[i] - b->v[i] - borrow;
+        r->v[i] = (uint64_t) t;
+        borrow = (uint64_t) (t >> 64) & 1;
+    }
+    return borrow;
+}
+
+// r = a + b over 256 bits, returns the carry
+static uint64_t raw_add(fe_t *r, const fe_t *a, const fe_t *b) {
+    uint64_t carry = 0;
+    for (int i = 0; i < 4; i++) {
+        u128 t = (u128) a->v[i] + b->v[i] + carry;
+        r->v[i] = (uint64_t) t;
+        carry = (uint64_t) (t >> 64);
+    }
+    return carry;
+}
+
+static void fe_add(fe_t *r, const fe_t *a, const fe_t *b) {
+    uint64_t carry = raw_add(r, a, b);
+    if (carry || fe_cmp(r, &P) >= 0) {
+        raw_sub(r, r, &P);
+    }
+}
+
+static void fe_sub(fe_t *r, const fe_t *a, const fe_t *b) {
+    if (raw_sub(r, a, b)) {
+        raw_add(r, r, &P);
+    }
+}
+
+static void fe_mul(fe_t *r, const fe_t *a, const fe_t *b) {
+    uint64_t t[8] = {0};
+    for (int i = 0; i < 4; i++) {
+        uint64_t carry = 0;
+        for (int j = 0; j < 4; j++) {
+            u128 m = (u128) a->v[i] * b->v[j] + t[i + j] + carry;
+            t[i + j] = (uint64_t) m;
+            carry = (uint64_t) (m >> 64);
+        }
+        t[i + 4] = carry;
+    }
+    // 2^256 = 0x1000003D1 (mod p)
+    const uint64_t c = 0x1000003D1ull;
+    uint64_t carry = 0;
+    fe_t out;
+    for (int i = 0; i < 4; i++) {
+        u128 m = (u128) t[i + 4] * c + t[i] + carry;
+        out.v[i] = (uint64_t) m;
+        carry = (uint64_t) (m >> 64);
+    }
+    while (carry) {
+        u128 m = (u128) carry * c;
+        fe_t extra = {{(uint64_t) m, (uint64_t) (m >> 64), 0, 0}};
+        carry = raw_add(&out, &out, &extra);
+    }
+    while (fe_cmp(&out, &P) >= 0) {
+        raw_sub(&out, &out, &P);
+    }
+    *r = out;
+}
+
+static void fe_pow(fe_t *r, const fe_t *a, const fe_t *e) {
+    fe_t result = {{1, 0, 0, 0}};
+    fe_t base = *a;
+    for (int i = 0; i < 256; i++) {
+        if ((e->v[i / 64] >> (i % 64)) & 1) {
+            fe_mul(&result, &result, &base);
+        }
+        fe_mul(&base, &base, &base);
+    }
+    *r = result;
+}
+
+static void fe_inv(fe_t *r, const fe_t *a) {
+    fe_t e = P;
+    e.v[0] -= 2;
+    fe_pow(r, a, &e);
+}
+
+typedef struct {
+    fe_t x, y, z;  // Jacobian coordinates; z == 0 is the point at infinity
+} jpoint_t;
+
+static void jp_double(jpoint_t *r, const jpoint_t *p) {
+    if (fe_is_zero(&p->z) || fe_is_zero(&p->y)) {
+        memset(r, 0, sizeof(jpoint_t));
+        return;
+    }
+    fe_t y2, s, m, t, x3, y3, z3;
+    fe_mul(&y2, &p->y, &p->y);
+    fe_mul(&s, &p->x, &y2);
+    fe_add(&s, &s, &s);
+    fe_add(&s, &s, &s);  // S = 4 X Y^2
+    fe_mul(&m, &p->x, &p->x);
+    fe_add(&t, &m, &m);
+    fe_add(&m, &t, &m);  // M = 3 X^2
+    fe_mul(&x3, &m, &m);
+    fe_sub(&x3, &x3, &s);
+    fe_sub(&x3, &x3, &s);  // X' = M^2 - 2S
+    fe_mul(&t, &y2, &y2);
+    fe_add(&t, &t, &t);
+    fe_add(&t, &t, &t);
+    fe_add(&t, &t, &t);  // 8 Y^4
+    fe_sub(&y3, &s, &x3);
+    fe_mul(&y3, &y3, &m);
+    fe_sub(&y3, &y3, &t);
+    fe_mul(&z3, &p->y, &p->z);
+    fe_add(&z3, &z3, &z3);
+    r->x = x3;
+    r->y = y3;
+    r->z = z3;
+}
+
+static void jp_add(jpoint_t *r, const jpoint_t *p, const jpoint_t *q) {
+    if (fe_is_zero(&p->z)) {
+        *r = *q;
+        return;
+    }
+    if (fe_is_zero(&q->z)) {
+        *r = *p;
+        return;
+    }
+    fe_t z1z1, z2z2, u1, u2, s1, s2, h, rr, hh, hhh, v, x3, y3, z3;
+    fe_mul(&z1z1, &p->z, &p->z);
+    fe_mul(&z2z2, &q->z, &q->z);
+    fe_mul(&u1, &p->x, &z2z2);
+    fe_mul(&u2, &q->x, &z1z1);
+    fe_mul(&s1, &p->y, &q->z);
+    fe_mul(&s1, &s1, &z2z2);
+    fe_mul(&s2, &q->y, &p->z);
+    fe_mul(&s2, &s2, &z1z1);
+    if (fe_cmp(&u1, &u2) == 0) {
+        if (fe_cmp(&s1, &s2) == 0) {
+            jp_double(r, p);
+        } else {
+            memset(r, 0, sizeof(jpoint_t));
+        }
+        return;
+    }
+    fe_sub(&h, &u2, &u1);
+    fe_sub(&rr, &s2, &s1);
+    fe_mul(&hh, &h, &h);
+    fe_mul(&hhh, &hh, &h);
+    fe_mul(&v, &u1, &hh);
+    fe_mul(&x3, &rr, &rr);
+    fe_sub(&x3, &x3, &hhh);
+    fe_sub(&x3, &x3, &v);
+    fe_sub(&x3, &x3, &v);
+    fe_sub(&y3, &v, &x3);
+    fe_mul(&y3, &y3, &rr);
+    fe_mul(&s1, &s1, &hhh);
+    fe_sub(&y3, &y3, &s1);
+    fe_mul(&z3, &p->z, &q->z);
+    fe_mul(&z3, &z3, &h);
+    r->x = x3;
+    r->y = y3;
+    r->z = z3;
+}
+
+static bool jp_to_affine(point_t *r, const jpoint_t *p) {
+    if (fe_is_zero(&p->z)) {
+        return false;
+    }
+    fe_t zi, zi2, zi3;
+    fe_inv(&zi, &p->z);
+    fe_mul(&zi2, &zi, &zi);
+    fe_mul(&zi3, &zi2, &zi);
+    fe_mul(&r->x, &p->x, &zi2);
+    fe_mul(&r->y, &p->y, &zi3);
+    return true;
+}
+
+bool secp_scalar_is_valid(const fe_t *k) {
+    return !fe_is_zero(k) && fe_cmp(k, &N) < 0;
+}
+
+bool secp_lift_x(point_t *r, const fe_t *x) {
+    if (fe_cmp(x, &P) >= 0) {
+        return false;
+    }
+    fe_t y2, y, check;
+    fe_t seven = {{7, 0, 0, 0}};
+    fe_mul(&y2, x, x);
+    fe_mul(&y2, &y2, x);
+    fe_add(&y2, &y2, &seven);
+    // p = 3 mod 4, so the square root is y2^((p+1)/4)
+    fe_t e = {{0xFFFFFFFFBFFFFF0Cull,
+               0xFFFFFFFFFFFFFFFFull,
+               0xFFFFFFFFFFFFFFFFull,
+               0x3FFFFFFFFFFFFFFFull}};
+    fe_pow(&y, &y2, &e);
+    fe_mul(&check, &y, &y);
+    if (fe_cmp(&check, &y2) != 0) {
+        return false;
+    }
+    if (y.v[0] & 1) {
+        fe_sub(&y, &P, &y);
+    }
+    r->x = *x;
+    r->y = y;
+    return true;
+}
+
+bool secp_mul_add(point_t *r, const fe_t *k, const point_t *base, const point_t *addend) {
+    jpoint_t acc;
+    jpoint_t b = {base->x, base->y, {{1, 0, 0, 0}}};
+    memset(&acc, 0, sizeof(acc));
+    for (int i = 255; i >= 0; i--) {
+        jp_double(&acc, &acc);
+        if ((k->v[i / 64] >> (i % 64)) & 1) {
+            jp_add(&acc, &acc, &b);
+        }
+    }
+    if (addend != NULL) {
+        jpoint_t a = {addend->x, addend->y, {{1, 0, 0, 0}}};
+        jp_add(&acc, &acc, &a);
+    }
+    return jp_to_affine(r, &acc);
+}
+
+bool secp_mul_g(point_t *r, const fe_t *k) {
+    point_t g = {GX, GY};
+    return secp_mul_add(r, k, &g, NULL);
+}
+
+bool secp_add(point_t *r, const point_t *a, const point_t *b) {
+    jpoint_t ja = {a->x, a->y, {{1, 0, 0, 0}}};
+    jpoint_t jb = {b->x, b->y, {{1, 0, 0, 0}}};
+    jp_add(&ja, &ja, &jb);
+    return jp_to_affine(r, &ja);
+}
+
+void secp_scalar_add(fe_t *r, const fe_t *a, const fe_t *b) {
+    uint64_t carry = raw_add(r, a, b);
+    if (carry || fe_cmp(r, &N) >= 0) {
+        raw_sub(r, r, &N);
+    }
+}
+
+void secp_scalar_negate(fe_t *r, const fe_t *a) {
+    if (fe_is_zero(a)) {
+        *r = *a;
+        return;
+    }
+    raw_sub(r, &N, a);
+}
@@ -0,0 +1,23 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+typedef struct {
+    uint64_t v[4];  // little-endian 64-bit limbs
+} fe_t;
+
+typedef struct {
+    fe_t x, y;
+} point_t;
+
+void fe_from_bytes(fe_t *r, const uint8_t in[32]);
+void fe_to_bytes(uint8_t out[32], const fe_t *a);
+
+bool secp_scalar_is_valid(const fe_t *k);
+void secp_scalar_add(fe_t *r, const fe_t *a, const fe_t *b);
+void secp_scalar_negate(fe_t *r, const fe_t *a);
+bool secp_lift_x(point_t *r, const fe_t *x);
+bool secp_mul_g(point_t *r, const fe_t *k);
+bool secp_mul_add(point_t *r, const fe_t *k, const point_t *base, const point_t *addend);
+bool secp_add(point_t *r, const point_t *a, const point_t *b);
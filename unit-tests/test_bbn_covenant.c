@@ -0,0 +1,79 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include "bbn_data.h"
+#include "bbn_tlv.h"
+#include "bbn_covenant.h"
+#include "bbn_test.h"
+#include "bbn_vectors.h"
+
+// The signet committee, with its keys in the given order
+static void load_committee(const int order[VEC_COV_COUNT], uint8_t quorum) {
+    bbn_data_begin(BBN_DATA_POOL_SIZE);
+    uint8_t *keys = bbn_data_pool_alloc(&g_bbn_data.cov_key_list, VEC_COV_COUNT * 32);
+    for (int i = 0; i < VEC_COV_COUNT; i++) {
+        hex_to_bytes(VEC_COV_PKS[order[i]], keys + 32 * i, 32);
+    }
+    g_bbn_data.fields |= BBN_FIELD(BBN_FIELD_COV_KEY_LIST);
+    g_bbn_data.cov_key_count = VEC_COV_COUNT;
+    g_bbn_data.fields |= BBN_FIELD(BBN_FIELD_COV_QUORUM);
+    g_bbn_data.cov_quorum = quorum;
+}
+
+static const int SORTED[VEC_COV_COUNT] = {0, 1, 2, 3, 4, 5, 6, 7, 8};
+static const int SHUFFLED[VEC_COV_COUNT] = {4, 8, 0, 6, 2, 7, 1, 5, 3};
+
+static void test_known_committee_in_any_order(void) {
+    load_committee(SORTED, VEC_COV_QUORUM);
+    const char *name = bbn_covenant_known_committee();
+    CHECK(name != NULL && strcmp(name, "Babylon testnet covenant committee v1") == 0);
+
+    load_committee(SHUFFLED, VEC_COV_QUORUM);
+    CHECK(bbn_covenant_known_committee() == name);
+}
+
+static void test_other_sets_are_unknown(void) {
+    load_committee(SORTED, VEC_COV_QUORUM - 1);
+    CHECK(bbn_covenant_known_committee() == NULL);
+
+    // one key less in the scripts
+    load_committee(SORTED, VEC_COV_QUORUM);
+    g_bbn_data.cov_key_count--;
+    CHECK(bbn_covenant_known_committee() == NULL);
+
+    // more keys announced than received
+    load_committee(SORTED, VEC_COV_QUORUM);
+    g_bbn_data.cov_key_count++;
+    CHECK(bbn_covenant_known_committee() == NULL);
+
+    // a repeated key, standing for the one it replaces
+    load_committee(SORTED, VEC_COV_QUORUM);
+    memcpy(bbn_data_pool() + g_bbn_data.cov_key_list.offset,
+           bbn_data_pool() + g_bbn_data.cov_key_list.offset + 32,
+           32);
+    CHECK(bbn_covenant_known_committee() == NULL);
+}
+
+static void test_hash_ignores_order(void) {
+    uint8_t keys[2 * 32], swapped[2 * 32], hash[32], other[32];
+
+    memset(keys, 1, 32);
+    memset(keys + 32, 2, 32);
+    memcpy(swapped, keys + 32, 32);
+    memcpy(swapped + 32, keys, 32);
+    CHECK(bbn_covenant_committee_hash(keys, 2, 1, hash));
+    CHECK(bbn_covenant_committee_hash(swapped, 2, 1, other));
+    CHECK_MEM(hash, other, 32);
+    CHECK(bbn_covenant_committee_hash(keys, 2, 2, other));
+    CHECK(memcmp(hash, other, 32) != 0);
+
+    memcpy(keys + 32, keys, 32);
+    CHECK(!bbn_covenant_committee_hash(keys, 2, 1, hash));
+}
+
+int main(void) {
+    RUN_TEST(test_known_committee_in_any_order);
+    RUN_TEST(test_other_sets_are_unknown);
+    RUN_TEST(test_hash_ignores_order);
+    return TEST_RESULT();
+}
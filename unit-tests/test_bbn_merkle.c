@@ -0,0 +1,75 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include "bitcoin_app_base/src/common/merkle.h"
+#include "bbn_def.h"
+#include "bbn_merkle.h"
+#include "bbn_test.h"
+
+// BBN_MAX_TLV_DATA_LEN uploaded in 1-byte chunks
+#define MAX_LEAVES BBN_MAX_TLV_DATA_LEN
+
+static uint8_t g_leaf_hashes[MAX_LEAVES][32];
+
+// Reference root, computed recursively: the left subtree holds the largest power of 2 < size
+static void reference_root(size_t first, size_t size, uint8_t out[32]) {
+    if (size == 1) {
+        memcpy(out, g_leaf_hashes[first], 32);
+        return;
+    }
+    size_t left_size = 1;
+    while (left_size * 2 < size) {
+        left_size *= 2;
+    }
+    uint8_t left[32], right[32];
+    reference_root(first, left_size, left);
+    reference_root(first + left_size, size - left_size, right);
+    merkle_combine_hashes(left, right, out);
+}
+
+static uint8_t g_leaves[MAX_LEAVES][8];
+
+static void check_stream(size_t n) {
+    bbn_merkle_stream_t stream;
+    bbn_merkle_stream_init(&stream);
+    for (size_t i = 0; i < n; i++) {
+        CHECK(bbn_merkle_stream_add_leaf(&stream, g_leaves[i], 1 + i % 8));
+    }
+    uint8_t root[32], expected[32];
+    CHECK(bbn_merkle_stream_root(&stream, root));
+    reference_root(0, n, expected);
+    CHECK_MEM(root, expected, 32);
+}
+
+static void test_stream_matches_reference(void) {
+    for (size_t i = 0; i < MAX_LEAVES; i++) {
+        memset(g_leaves[i], (int) i, sizeof(g_leaves[i]));
+        // the last leaf of a TLV upload is usually shorter
+        merkle_compute_element_hash(g_leaves[i], 1 + i % 8, g_leaf_hashes[i]);
+    }
+
+    for (size_t n = 1; n <= 40; n++) {
+        check_stream(n);
+    }
+    // around the powers of 2 where the number of subtrees peaks, up to the largest upload
+    for (size_t n = 64; n <= MAX_LEAVES; n *= 2) {
+        check_stream(n - 1);
+        check_stream(n);
+        if (n < MAX_LEAVES) {
+            check_stream(n + 1);
+        }
+    }
+}
+
+static void test_empty_stream_has_no_root(void) {
+    bbn_merkle_stream_t stream;
+    uint8_t root[32];
+    bbn_merkle_stream_init(&stream);
+    CHECK(!bbn_merkle_stream_root(&stream, root));
+}
+
+int main(void) {
+    RUN_TEST(test_stream_matches_reference);
+    RUN_TEST(test_empty_stream_has_no_root);
+    return TEST_RESULT();
+}
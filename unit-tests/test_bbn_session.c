@@ -0,0 +1,138 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include "bbn_def.h"
+#include "bbn_data.h"
+#include "bbn_tlv.h"
+#include "bbn_session.h"
+#include "bbn_test.h"
+
+// A parameter set with the given number of covenant keys, all filled with id, and optionally a
+// message taking the rest of the pool
+static void store_params_with_keys(uint8_t id, uint8_t cov_count, bool full) {
+    uint8_t tlv_hash[32];
+
+    // as many bytes as the TLV data would reserve
+    bbn_data_begin(full ? BBN_DATA_POOL_SIZE : 32 * cov_count);
+    g_bbn_data.fields |= BBN_FIELD(BBN_FIELD_COV_QUORUM);
+    g_bbn_data.cov_quorum = id;
+    g_bbn_data.fields |= BBN_FIELD(BBN_FIELD_COV_KEY_LIST);
+    g_bbn_data.cov_key_count = cov_count;
+    memset(bbn_data_pool_alloc(&g_bbn_data.cov_key_list, 32 * cov_count), id, 32 * cov_count);
+    if (full) {
+        g_bbn_data.fields |= BBN_FIELD(BBN_FIELD_MESSAGE);
+        bbn_data_pool_alloc(&g_bbn_data.message, BBN_DATA_POOL_SIZE - g_bbn_data.pool_len);
+    }
+    memset(tlv_hash, id, sizeof(tlv_hash));
+    bbn_session_store_params(tlv_hash);
+}
+
+static void store_params(uint8_t id) {
+    store_params_with_keys(id, 1, false);
+}
+
+static bool load_params(uint8_t id) {
+    uint8_t tlv_hash[32];
+
+    memset(tlv_hash, id, sizeof(tlv_hash));
+    bbn_data_reset();
+    if (!bbn_session_load_params(tlv_hash) || g_bbn_data.cov_quorum != id) {
+        return false;
+    }
+    for (size_t i = 0; i < g_bbn_data.cov_key_count; i++) {
+        const uint8_t *key = bbn_data_cov_key(i);
+        if (key == NULL || key[0] != id || key[31] != id) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static void test_store_and_load(void) {
+    store_params(1);
+    // the values parsed are the ones stored, still in use
+    CHECK(bbn_data_cov_key(0) != NULL && bbn_data_cov_key(0)[0] == 1);
+    store_params(2);
+    CHECK(bbn_data_cov_key(0) != NULL && bbn_data_cov_key(0)[0] == 2);
+    CHECK(load_params(1));
+    CHECK(!load_params(42));
+}
+
+static void test_least_recently_used_is_evicted(void) {
+    for (uint8_t id = 1; id <= BBN_SESSION_CACHE_SIZE; id++) {
+        store_params(id);
+    }
+    CHECK(load_params(1));  // 2 is now the least recently used
+    store_params(BBN_SESSION_CACHE_SIZE + 1);
+    CHECK(load_params(1));
+    CHECK(!load_params(2));
+    for (uint8_t id = 3; id <= BBN_SESSION_CACHE_SIZE + 1; id++) {
+        CHECK(load_params(id));
+    }
+}
+
+static void test_large_sets_evict_by_size(void) {
+    store_params_with_keys(1, 9, false);
+    store_params_with_keys(2, 9, false);
+    CHECK(load_params(1));
+    CHECK(load_params(2));
+
+    // the largest set only fits next to a typical one: the older one goes
+    store_params_with_keys(3, MAX_COV_KEY_COUNT, true);
+    CHECK(!load_params(1));
+    CHECK(load_params(2));
+    CHECK(load_params(3));
+
+    // stored again, a set replaces its previous copy and the others move down
+    store_params_with_keys(2, 9, false);
+    CHECK(load_params(3));
+    CHECK(load_params(2));
+}
+
+static void test_bundle_lifecycle(void) {
+    uint8_t tlv_hash[32], staker_pk[32], other_pk[32];
+    uint8_t mask = (1 << BBN_POLICY_STAKE_TRANSFER) | (1 << BBN_POLICY_UNBOND);
+
+    memset(staker_pk, 0xaa, sizeof(staker_pk));
+    memset(other_pk, 0xbb, sizeof(other_pk));
+    store_params(5);
+    memset(tlv_hash, 5, sizeof(tlv_hash));
+
+    CHECK(!bbn_session_bundle_begin(tlv_hash, 0));
+    CHECK(!bbn_session_bundle_begin(tlv_hash, 1 << 7));
+    // the parameters must have the fields of every action of the bundle
+    CHECK(!bbn_session_bundle_begin(tlv_hash, mask));
+    g_bbn_data.fields |= BBN_REQUIRED_STAKING | BBN_REQUIRED_UNBOND;
+    bbn_session_store_params(tlv_hash);
+    // and a timelock for the staking output and one for the unbonding output
+    CHECK(!bbn_session_bundle_begin(tlv_hash, mask));
+    CHECK(bbn_session_bundle_begin(tlv_hash, 1 << BBN_POLICY_UNBOND));
+    g_bbn_data.fields |= BBN_FIELD(BBN_FIELD_UNBONDING_TIMELOCK);
+    bbn_session_store_params(tlv_hash);
+    CHECK(bbn_session_bundle_begin(tlv_hash, mask));
+    CHECK(bbn_session_bundle_actions() == mask);
+
+    CHECK(bbn_session_bundle_state(BBN_POLICY_SLASHING, staker_pk) == BBN_BUNDLE_NONE);
+    CHECK(bbn_session_bundle_state(BBN_POLICY_STAKE_TRANSFER, staker_pk) ==
+          BBN_BUNDLE_PENDING_REVIEW);
+    bbn_session_bundle_consume(BBN_POLICY_STAKE_TRANSFER, staker_pk);
+
+    // the approval is bound to the staker key, and to the parameters in use
+    CHECK(bbn_session_bundle_state(BBN_POLICY_UNBOND, other_pk) == BBN_BUNDLE_NONE);
+    CHECK(bbn_session_bundle_state(BBN_POLICY_UNBOND, staker_pk) == BBN_BUNDLE_REVIEWED);
+    bbn_session_clear_current();
+    CHECK(bbn_session_bundle_state(BBN_POLICY_UNBOND, staker_pk) == BBN_BUNDLE_NONE);
+    CHECK(bbn_session_load_params(tlv_hash));
+
+    bbn_session_bundle_consume(BBN_POLICY_UNBOND, staker_pk);
+    CHECK(bbn_session_bundle_actions() == 0);
+    CHECK(bbn_session_bundle_state(BBN_POLICY_UNBOND, staker_pk) == BBN_BUNDLE_NONE);
+}
+
+int main(void) {
+    RUN_TEST(test_store_and_load);
+    RUN_TEST(test_least_recently_used_is_evicted);
+    RUN_TEST(test_large_sets_evict_by_size);
+    RUN_TEST(test_bundle_lifecycle);
+    return TEST_RESULT();
+}
@@ -0,0 +1,247 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include "bitcoin_app_base/src/crypto.h"
+#include "bitcoin_app_base/src/handler/sign_psbt.h"
+#include "bbn_def.h"
+#include "bbn_data.h"
+#include "bbn_hash.h"
+#include "bbn_tlv.h"
+#include "bbn_taptree.h"
+#include "bbn_address.h"
+#include "bbn_test.h"
+#include "bbn_vectors.h"
+
+static void load_vectors(uint64_t timelock) {
+    bbn_data_begin(BBN_DATA_POOL_SIZE);
+    hex_to_bytes(VEC_STAKER_PK, g_bbn_data.staker_pk, 32);
+    g_bbn_data.fields |= BBN_FIELD(BBN_FIELD_STAKER_PK);
+    hex_to_bytes(VEC_FP_PK, bbn_data_pool_alloc(&g_bbn_data.fp_list, 32), 32);
+    g_bbn_data.fp_count = 1;
+    g_bbn_data.fields |= BBN_FIELD(BBN_FIELD_FP_COUNT);
+    g_bbn_data.fields |= BBN_FIELD(BBN_FIELD_FP_LIST);
+    uint8_t *cov_keys = bbn_data_pool_alloc(&g_bbn_data.cov_key_list, VEC_COV_COUNT * 32);
+    for (int i = 0; i < VEC_COV_COUNT; i++) {
+        hex_to_bytes(VEC_COV_PKS[i], cov_keys + 32 * i, 32);
+    }
+    g_bbn_data.cov_key_count = VEC_COV_COUNT;
+    g_bbn_data.fields |= BBN_FIELD(BBN_FIELD_COV_KEY_COUNT);
+    g_bbn_data.fields |= BBN_FIELD(BBN_FIELD_COV_KEY_LIST);
+    g_bbn_data.cov_quorum = VEC_COV_QUORUM;
+    g_bbn_data.fields |= BBN_FIELD(BBN_FIELD_COV_QUORUM);
+    g_bbn_data.timelock = timelock;
+    g_bbn_data.fields |= BBN_FIELD(BBN_FIELD_TIMELOCK);
+    bbn_taptree_invalidate();
+}
+
+static void check_hex(const uint8_t *actual, const char *expected_hex) {
+    uint8_t expected[32];
+    hex_to_bytes(expected_hex, expected, 32);
+    CHECK_MEM(actual, expected, 32);
+}
+
+// The midstates must give the same hashes as tagging from scratch, for data of one or more blocks.
+static void test_tagged_hash_midstates(void) {
+    static const char *tags[BBN_TAG_COUNT] = {
+        [BBN_TAG_BIP322_MESSAGE] = "BIP0322-signed-message",
+        [BBN_TAG_TAPLEAF] = "TapLeaf",
+        [BBN_TAG_TAPBRANCH] = "TapBranch",
+        [BBN_TAG_TAPTWEAK] = "TapTweak",
+    };
+    uint8_t data[150];
+    uint8_t expected[32], actual[32];
+    cx_sha256_t ctx;
+
+    for (size_t i = 0; i < sizeof(data); i++) {
+        data[i] = (uint8_t) i;
+    }
+    for (int tag = 0; tag < BBN_TAG_COUNT; tag++) {
+        for (size_t len = 0; len <= sizeof(data); len += 75) {
+            crypto_tr_tagged_hash_init(&ctx, (const uint8_t *) tags[tag], strlen(tags[tag]));
+            crypto_hash_update(&ctx.header, data, len);
+            crypto_hash_digest(&ctx.header, expected, 32);
+
+            bbn_tagged_hash_init(&ctx, tag);
+            crypto_hash_update(&ctx.header, data, len);
+            crypto_hash_digest(&ctx.header, actual, 32);
+            CHECK_MEM(actual, expected, 32);
+        }
+    }
+
+    // the self-test of the debug builds agrees
+    uint8_t digests[BBN_TAG_COUNT * 32];
+    CHECK(bbn_tagged_hash_selftest(data, sizeof(data), digests) == 0);
+    bbn_tagged_hash_init(&ctx, BBN_TAG_TAPTWEAK);
+    crypto_hash_update(&ctx.header, data, sizeof(data));
+    crypto_hash_digest(&ctx.header, actual, 32);
+    CHECK_MEM(digests + 32 * BBN_TAG_TAPTWEAK, actual, 32);
+
+    crypto_tr_combine_taptree_hashes(data, data + 32, expected);
+    bbn_tapbranch_hash(data + 32, data, actual);
+    CHECK_MEM(actual, expected, 32);
+}
+
+static void test_leaf_hashes(void) {
+    uint8_t hash[32];
+
+    load_vectors(VEC_TIMELOCK);
+    CHECK(bbn_taptree_leafhash(BBN_LEAF_SLASHING, hash));
+    check_hex(hash, VEC_SLASHING_LEAFHASH);
+    CHECK(bbn_taptree_leafhash(BBN_LEAF_TIMELOCK, hash));
+    check_hex(hash, VEC_TIMELOCK_LEAFHASH);
+}
+
+// TapLeaf hash of a script written out by hand.
+// With two FPs, every FP key has its own push, and the FP quorum comes before OP_NUMEQUALVERIFY.
+static void test_multi_fp_vectors(void) {
+    uint8_t key[32];
+
+    load_vectors(VEC_STAKING_TIMELOCK);
+    uint8_t *fp_keys = bbn_data_pool_alloc(&g_bbn_data.fp_list, 2 * 32);
+    hex_to_bytes(VEC_COV_PKS[0], fp_keys, 32);
+    hex_to_bytes(VEC_FP_PK, fp_keys + 32, 32);
+    g_bbn_data.fp_count = 2;
+    g_bbn_data.fp_quorum = 1;
+    g_bbn_data.fields |= BBN_FIELD(BBN_FIELD_FP_QUORUM);
+
+    CHECK(bbn_taptree_leafhash(BBN_LEAF_SLASHING, key));
+    check_hex(key, VEC_MULTI_FP_SLASHING_LEAFHASH);
+    CHECK(bbn_taptree_output_key(BBN_TREE_STAKING, key));
+    check_hex(key, VEC_MULTI_FP_STAKING_OUTPUT_KEY);
+
+    g_bbn_data.fields &= ~BBN_FIELD(BBN_FIELD_FP_QUORUM);
+    bbn_taptree_invalidate();
+    CHECK(!bbn_taptree_leafhash(BBN_LEAF_SLASHING, key));
+}
+
+// 16 is OP_16, as a timelock and as a quorum.
+static void test_number_16_vectors(void) {
+    uint8_t key[32];
+
+    load_vectors(16);
+    CHECK(bbn_taptree_leafhash(BBN_LEAF_TIMELOCK, key));
+    check_hex(key, VEC_TIMELOCK16_LEAFHASH);
+    CHECK(bbn_taptree_output_key(BBN_TREE_TIMELOCK, key));
+    check_hex(key, VEC_TIMELOCK16_CHANGE_OUTPUT_KEY);
+
+    load_vectors(VEC_STAKING_TIMELOCK);
+    uint8_t *cov_keys = bbn_data_pool_alloc(&g_bbn_data.cov_key_list, 16 * 32);
+    for (int i = 0; i < 16; i++) {
+        memset(cov_keys + 32 * i, i + 1, 32);
+    }
+    g_bbn_data.cov_key_count = 16;
+    g_bbn_data.cov_quorum = 16;
+    CHECK(bbn_taptree_leafhash(BBN_LEAF_UNBONDING, key));
+    check_hex(key, VEC_QUORUM16_UNBONDING_LEAFHASH);
+    CHECK(bbn_taptree_output_key(BBN_TREE_STAKING, key));
+    check_hex(key, VEC_QUORUM16_STAKING_OUTPUT_KEY);
+}
+
+static void test_staking_root(void) {
+    uint8_t slashing[32], branch[32], expected[32], root[32];
+
+    load_vectors(VEC_STAKING_TIMELOCK);
+    hex_to_bytes(VEC_SLASHING_LEAFHASH, slashing, 32);
+    hex_to_bytes(VEC_STAKING_BRANCH, branch, 32);
+    crypto_tr_combine_taptree_hashes(slashing, branch, expected);
+    CHECK(bbn_taptree_root(BBN_TREE_STAKING, root));
+    CHECK_MEM(root, expected, 32);
+}
+
+static void test_output_keys(void) {
+    uint8_t key[32];
+
+    load_vectors(VEC_STAKING_TIMELOCK);
+    CHECK(bbn_taptree_output_key(BBN_TREE_STAKING, key));
+    check_hex(key, VEC_STAKING_OUTPUT_KEY);
+
+    load_vectors(VEC_TIMELOCK);
+    CHECK(bbn_taptree_output_key(BBN_TREE_UNBONDING, key));
+    check_hex(key, VEC_UNBOND_OUTPUT_KEY);
+    CHECK(bbn_taptree_output_key(BBN_TREE_TIMELOCK, key));
+    check_hex(key, VEC_CHANGE_OUTPUT_KEY);
+
+    const uint8_t *view = bbn_taptree_output_key_view(BBN_TREE_UNBONDING);
+    CHECK(view != NULL);
+    check_hex(view, VEC_UNBOND_OUTPUT_KEY);
+    CHECK(bbn_taptree_output_key_view(BBN_TREE_COUNT) == NULL);
+}
+
+// One parameter set with both timelocks gives every output key of a delegation, by action.
+static void test_delegation_timelocks(void) {
+    uint8_t key[32], change[32];
+
+    load_vectors(VEC_STAKING_TIMELOCK);
+    g_bbn_data.unbonding_timelock = VEC_TIMELOCK;
+    g_bbn_data.fields |= BBN_FIELD(BBN_FIELD_UNBONDING_TIMELOCK);
+    g_bbn_data.fields |= BBN_FIELD(BBN_FIELD_ACTION_TYPE);
+
+    g_bbn_data.action_type = BBN_POLICY_STAKE_TRANSFER;
+    bbn_taptree_invalidate();
+    CHECK(bbn_taptree_output_key(BBN_TREE_STAKING, key));
+    check_hex(key, VEC_STAKING_OUTPUT_KEY);
+
+    g_bbn_data.action_type = BBN_POLICY_UNBOND;
+    bbn_taptree_invalidate();
+    CHECK(bbn_taptree_output_key(BBN_TREE_UNBONDING, key));
+    check_hex(key, VEC_UNBOND_OUTPUT_KEY);
+
+    g_bbn_data.action_type = BBN_POLICY_SLASHING_UNBONDING;
+    bbn_taptree_invalidate();
+    CHECK(bbn_taptree_output_key(BBN_TREE_TIMELOCK, key));
+    check_hex(key, VEC_CHANGE_OUTPUT_KEY);
+
+    // an action type out of the enum is not an unbonding action
+    CHECK(bbn_data_timelock(BBN_POLICY_COUNT) == VEC_STAKING_TIMELOCK);
+    CHECK(bbn_data_timelock(UINT32_MAX) == VEC_STAKING_TIMELOCK);
+
+    // without the tag, every action uses the timelock of tag 0x71
+    g_bbn_data.fields &= ~BBN_FIELD(BBN_FIELD_UNBONDING_TIMELOCK);
+    bbn_taptree_invalidate();
+    CHECK(bbn_data_timelock(BBN_POLICY_SLASHING_UNBONDING) == VEC_STAKING_TIMELOCK);
+    CHECK(bbn_taptree_output_key(BBN_TREE_TIMELOCK, key));
+    hex_to_bytes(VEC_CHANGE_OUTPUT_KEY, change, 32);
+    CHECK(memcmp(key, change, 32) != 0);
+}
+
+static void test_invalidate_after_parameter_change(void) {
+    uint8_t before[32], after[32];
+
+    load_vectors(VEC_TIMELOCK);
+    CHECK(bbn_taptree_output_key(BBN_TREE_STAKING, before));
+    g_bbn_data.timelock = VEC_TIMELOCK + 1;
+    bbn_taptree_invalidate();
+    CHECK(bbn_taptree_output_key(BBN_TREE_STAKING, after));
+    CHECK(memcmp(before, after, 32) != 0);
+}
+
+static void test_staking_address(void) {
+    sign_psbt_state_t st;
+
+    load_vectors(VEC_STAKING_TIMELOCK);
+    memset(&st, 0, sizeof(st));
+    st.outputs.output_scripts[0][0] = 0x51;
+    st.outputs.output_scripts[0][1] = 0x20;
+    hex_to_bytes(VEC_STAKING_OUTPUT_KEY, st.outputs.output_scripts[0] + 2, 32);
+    st.outputs.output_script_lengths[0] = 34;
+    CHECK(bbn_check_staking_address(&st));
+
+    st.outputs.output_scripts[0][33] ^= 1;
+    CHECK(!bbn_check_staking_address(&st));
+
+    g_bbn_data.fields &= ~BBN_FIELD(BBN_FIELD_FP_LIST);
+    CHECK(!bbn_check_staking_address(&st));
+}
+
+int main(void) {
+    RUN_TEST(test_tagged_hash_midstates);
+    RUN_TEST(test_leaf_hashes);
+    RUN_TEST(test_multi_fp_vectors);
+    RUN_TEST(test_number_16_vectors);
+    RUN_TEST(test_staking_root);
+    RUN_TEST(test_output_keys);
+    RUN_TEST(test_delegation_timelocks);
+    RUN_TEST(test_invalidate_after_parameter_change);
+    RUN_TEST(test_staking_address);
+    return TEST_RESULT();
+}
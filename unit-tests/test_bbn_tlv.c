@@ -0,0 +1,196 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include "bbn_def.h"
+#include "bbn_data.h"
+#include "bbn_tlv.h"
+#include "bbn_script.h"
+#include "bbn_test.h"
+#include "bbn_vectors.h"
+
+static size_t put_tlv(uint8_t *out, uint8_t tag, const uint8_t *value, uint16_t len) {
+    out[0] = tag;
+    out[1] = len >> 8;
+    out[2] = len & 0xff;
+    memcpy(out + 3, value, len);
+    return 3 + len;
+}
+
+static size_t build_staking_tlv(uint8_t *buf) {
+    uint8_t key[32];
+    uint8_t cov_keys[VEC_COV_COUNT * 32];
+    size_t len = 0;
+
+    len += put_tlv(buf + len, TAG_ACTION_TYPE, (uint8_t[]){BBN_POLICY_STAKE_TRANSFER}, 1);
+    len += put_tlv(buf + len, TAG_FP_COUNT, (uint8_t[]){1}, 1);
+    hex_to_bytes(VEC_FP_PK, key, 32);
+    len += put_tlv(buf + len, TAG_FP_LIST, key, 32);
+    len += put_tlv(buf + len, TAG_COV_KEY_COUNT, (uint8_t[]){VEC_COV_COUNT}, 1);
+    for (int i = 0; i < VEC_COV_COUNT; i++) {
+        hex_to_bytes(VEC_COV_PKS[i], cov_keys + 32 * i, 32);
+    }
+    len += put_tlv(buf + len, TAG_COV_KEY_LIST, cov_keys, sizeof(cov_keys));
+    len += put_tlv(buf + len, TAG_COV_QUORUM, (uint8_t[]){VEC_COV_QUORUM}, 1);
+    len += put_tlv(buf + len,
+                   TAG_TIMELOCK,
+                   (uint8_t[]){0, 0, 0, 0, 0, 0, VEC_TIMELOCK >> 8, VEC_TIMELOCK & 0xff},
+                   8);
+    len += put_tlv(buf + len,
+                   TAG_UNBONDING_TIMELOCK,
+                   (uint8_t[]){0, 0, 0, 0, 0, 0, VEC_TIMELOCK >> 8, (VEC_TIMELOCK & 0xff) + 1},
+                   8);
+    len += put_tlv(buf + len,
+                   TAG_BIP32_PATH,
+                   (uint8_t[]){0x80, 0, 0, 0x56, 0x80, 0, 0, 0x01, 0x80, 0, 0, 0},
+                   12);
+    return len;
+}
+
+static void check_staking_data(void) {
+    uint8_t key[32];
+
+    CHECK(BBN_DATA_HAS(BBN_FIELD_ACTION_TYPE));
+    CHECK(g_bbn_data.action_type == BBN_POLICY_STAKE_TRANSFER);
+    CHECK(BBN_DATA_HAS(BBN_FIELD_FP_COUNT) && g_bbn_data.fp_count == 1);
+    hex_to_bytes(VEC_FP_PK, key, 32);
+    CHECK(BBN_DATA_HAS(BBN_FIELD_FP_LIST));
+    CHECK(bbn_data_fp_key(0) != NULL && bbn_data_fp_key(1) == NULL);
+    CHECK_MEM(bbn_data_fp_key(0), key, 32);
+    CHECK(BBN_DATA_HAS(BBN_FIELD_COV_KEY_COUNT) && g_bbn_data.cov_key_count == VEC_COV_COUNT);
+    hex_to_bytes(VEC_COV_PKS[VEC_COV_COUNT - 1], key, 32);
+    CHECK(BBN_DATA_HAS(BBN_FIELD_COV_KEY_LIST));
+    CHECK(bbn_data_cov_key(VEC_COV_COUNT - 1) != NULL);
+    CHECK_MEM(bbn_data_cov_key(VEC_COV_COUNT - 1), key, 32);
+    // only the received keys take room
+    CHECK(g_bbn_data.pool_len == (1 + VEC_COV_COUNT) * 32);
+    CHECK(BBN_DATA_HAS(BBN_FIELD_COV_QUORUM) && g_bbn_data.cov_quorum == VEC_COV_QUORUM);
+    CHECK(BBN_DATA_HAS(BBN_FIELD_TIMELOCK) && g_bbn_data.timelock == VEC_TIMELOCK);
+    CHECK(BBN_DATA_HAS(BBN_FIELD_UNBONDING_TIMELOCK));
+    CHECK(g_bbn_data.unbonding_timelock == VEC_TIMELOCK + 1);
+    CHECK(g_bbn_data.derive_path_len == 3);
+    CHECK(g_bbn_data.derive_path[0] == 0x80000056 && g_bbn_data.derive_path[2] == 0x80000000);
+}
+
+static void test_parse_whole_buffer(void) {
+    uint8_t buf[512];
+    size_t len = build_staking_tlv(buf);
+
+    CHECK(parse_tlv_data(buf, len));
+    check_staking_data();
+}
+
+static void test_parse_at_every_split(void) {
+    uint8_t buf[512];
+    size_t len = build_staking_tlv(buf);
+
+    // the stream may be cut anywhere, including inside a tag header
+    for (size_t chunk = 1; chunk <= len; chunk++) {
+        bbn_tlv_parser_t parser;
+        bbn_tlv_parser_init(&parser, len);
+        bool ok = true;
+        for (size_t offset = 0; offset < len && ok; offset += chunk) {
+            size_t n = len - offset < chunk ? len - offset : chunk;
+            ok = bbn_tlv_parser_feed(&parser, buf + offset, n);
+        }
+        CHECK(ok && bbn_tlv_parser_finish(&parser));
+        check_staking_data();
+    }
+}
+
+static void test_reject_truncated_value(void) {
+    uint8_t buf[512];
+    size_t len = build_staking_tlv(buf);
+
+    bbn_tlv_parser_t parser;
+    bbn_tlv_parser_init(&parser, len);
+    CHECK(bbn_tlv_parser_feed(&parser, buf, len - 1));
+    CHECK(!bbn_tlv_parser_finish(&parser));
+}
+
+static void test_reject_invalid_entries(void) {
+    uint8_t buf[16 + 3 + 32 * (MAX_FP_COUNT + 1)];
+    uint8_t keys[32 * (MAX_FP_COUNT + 1)] = {0};
+
+    CHECK(!parse_tlv_data(buf, put_tlv(buf, 0xaa, (uint8_t[]){0}, 1)));
+    CHECK(!parse_tlv_data(buf, put_tlv(buf, TAG_STAKER_PK, keys, 31)));
+    CHECK(!parse_tlv_data(buf, put_tlv(buf, TAG_FP_LIST, keys, sizeof(keys))));
+    CHECK(!parse_tlv_data(buf, put_tlv(buf, TAG_BIP32_PATH, keys, 6)));
+}
+
+static void test_reject_incomplete_or_repeated_data(void) {
+    uint8_t buf[512];
+    size_t len = build_staking_tlv(buf);
+    size_t extra;
+
+    // a tag may only appear once
+    extra = put_tlv(buf + len, TAG_COV_QUORUM, (uint8_t[]){1}, 1);
+    CHECK(!parse_tlv_data(buf, len + extra));
+
+    // an unbonding also needs its fee limit
+    buf[3] = BBN_POLICY_UNBOND;
+    CHECK(!parse_tlv_data(buf, len));
+    extra = put_tlv(buf + len, TAG_UNBONDING_FEE_LIMIT, (uint8_t[]){0, 0, 0, 0, 0, 0, 3, 0xe8}, 8);
+    CHECK(parse_tlv_data(buf, len + extra));
+
+    // more keys announced than received
+    CHECK(!parse_tlv_data(buf, put_tlv(buf, TAG_COV_KEY_COUNT, (uint8_t[]){1}, 1)));
+}
+
+static void test_reset_clears_previous_data(void) {
+    uint8_t buf[512];
+    size_t len = build_staking_tlv(buf);
+
+    CHECK(parse_tlv_data(buf, len));
+    CHECK(parse_tlv_data(buf, put_tlv(buf, TAG_COV_QUORUM, (uint8_t[]){3}, 1)));
+    CHECK(!BBN_DATA_HAS(BBN_FIELD_FP_LIST) && !BBN_DATA_HAS(BBN_FIELD_TIMELOCK));
+    CHECK(g_bbn_data.cov_quorum == 3);
+
+    // a failure part-way through keeps none of the fields parsed before it
+    len = build_staking_tlv(buf);
+    CHECK(!parse_tlv_data(buf, len - 1));
+    CHECK(g_bbn_data.fields == 0);
+}
+
+static void test_long_message_is_hashed_as_it_streams(void) {
+    static uint8_t message[3000];
+    static uint8_t buf[3 + sizeof(message)];
+    uint8_t key[32], txid[32], expected[32];
+
+    for (size_t i = 0; i < sizeof(message); i++) {
+        message[i] = 'a' + i % 26;
+    }
+    hex_to_bytes(VEC_STAKER_PK, key, 32);
+    size_t len = put_tlv(buf, TAG_MESSAGE, message, sizeof(message));
+
+    bbn_tlv_parser_t parser;
+    bbn_tlv_parser_init(&parser, len);
+    for (size_t offset = 0; offset < len; offset += 64) {
+        CHECK(bbn_tlv_parser_feed(&parser, buf + offset, len - offset < 64 ? len - offset : 64));
+    }
+    CHECK(bbn_tlv_parser_finish(&parser));
+
+    CHECK(BBN_DATA_HAS(BBN_FIELD_MESSAGE) && g_bbn_data.message_len == sizeof(message));
+    CHECK(g_bbn_data.message.len == MAX_MESSAGE_LEN);
+    CHECK_MEM(bbn_data_message(), message, MAX_MESSAGE_LEN);
+    compute_bip322_txid_by_message(message, sizeof(message), key, expected);
+    compute_bip322_txid_by_message_hash(g_bbn_data.message_hash, key, txid);
+    CHECK_MEM(txid, expected, 32);
+
+    // a short message is kept whole
+    CHECK(parse_tlv_data(buf, put_tlv(buf, TAG_MESSAGE, message, 10)));
+    CHECK(g_bbn_data.message_len == 10 && g_bbn_data.message.len == 10);
+    compute_bip322_txid_by_message(message, 10, key, expected);
+    compute_bip322_txid_by_message_hash(g_bbn_data.message_hash, key, txid);
+    CHECK_MEM(txid, expected, 32);
+}
+
+int main(void) {
+    RUN_TEST(test_parse_whole_buffer);
+    RUN_TEST(test_parse_at_every_split);
+    RUN_TEST(test_reject_truncated_value);
+    RUN_TEST(test_reject_invalid_entries);
+    RUN_TEST(test_reject_incomplete_or_repeated_data);
+    RUN_TEST(test_reset_clears_previous_data);
+    RUN_TEST(test_long_message_is_hashed_as_it_streams);
+    return TEST_RESULT();
+}
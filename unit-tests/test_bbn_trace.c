@@ -0,0 +1,107 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include "bbn_data.h"
+#include "bbn_script.h"
+#include "bbn_trace.h"
+#include "bbn_test.h"
+
+#define DUMP_SIZE (1 + BBN_TRACE_SIZE * BBN_TRACE_ENTRY_LEN)
+
+static void check_entry(const uint8_t *entry, uint8_t phase, uint8_t event, uint16_t seq) {
+    CHECK(entry[0] == phase);
+    CHECK(entry[1] == event);
+    CHECK(entry[2] == seq >> 8 && entry[3] == (seq & 0xff));
+}
+
+static void test_dump_in_order(void) {
+    uint8_t dump[DUMP_SIZE];
+
+    bbn_trace_reset();
+    CHECK(bbn_trace_dump(dump, sizeof(dump)) == 1);
+    CHECK(dump[0] == 0);
+
+    BBN_TRACE_BEGIN(BBN_TRACE_SIGHASH);
+    BBN_TRACE_END(BBN_TRACE_SIGHASH);
+    BBN_TRACE_BEGIN(BBN_TRACE_SCHNORR_SIGN);
+    CHECK(bbn_trace_dump(dump, sizeof(dump)) == 1 + 3 * BBN_TRACE_ENTRY_LEN);
+    CHECK(dump[0] == 3);
+    check_entry(dump + 1, BBN_TRACE_SIGHASH, BBN_TRACE_BEGIN_EVENT, 0);
+    check_entry(dump + 1 + BBN_TRACE_ENTRY_LEN, BBN_TRACE_SIGHASH, BBN_TRACE_END_EVENT, 1);
+    check_entry(dump + 1 + 2 * BBN_TRACE_ENTRY_LEN,
+                BBN_TRACE_SCHNORR_SIGN,
+                BBN_TRACE_BEGIN_EVENT,
+                2);
+}
+
+static void test_wraps_keeping_latest(void) {
+    uint8_t dump[DUMP_SIZE];
+
+    bbn_trace_reset();
+    for (uint16_t i = 0; i < BBN_TRACE_SIZE + 5; i++) {
+        bbn_trace_record(i % BBN_TRACE_PHASE_COUNT, BBN_TRACE_BEGIN_EVENT);
+    }
+    CHECK(bbn_trace_dump(dump, sizeof(dump)) == DUMP_SIZE);
+    CHECK(dump[0] == BBN_TRACE_SIZE);
+    for (uint16_t i = 0; i < BBN_TRACE_SIZE; i++) {
+        uint16_t seq = i + 5;
+        check_entry(dump + 1 + i * BBN_TRACE_ENTRY_LEN,
+                    seq % BBN_TRACE_PHASE_COUNT,
+                    BBN_TRACE_BEGIN_EVENT,
+                    seq);
+    }
+
+    // a buffer too small for the whole trace gets nothing
+    CHECK(bbn_trace_dump(dump, sizeof(dump) - 1) == 0);
+}
+
+static uint32_t entry_ticks(const uint8_t *entry) {
+    return (uint32_t) entry[4] << 24 | (uint32_t) entry[5] << 16 | (uint32_t) entry[6] << 8 |
+           entry[7];
+}
+
+// The ticks come from the clock of the build, and grow over a phase that takes time.
+static void test_ticks_increase(void) {
+    uint8_t dump[DUMP_SIZE];
+
+    bbn_trace_reset();
+    BBN_TRACE_BEGIN(BBN_TRACE_SIGN_INPUTS);
+    uint32_t start = shim_clock_us();
+    while ((uint32_t) (shim_clock_us() - start) < 1000) {
+    }
+    BBN_TRACE_END(BBN_TRACE_SIGN_INPUTS);
+
+    CHECK(bbn_trace_dump(dump, sizeof(dump)) == 1 + 2 * BBN_TRACE_ENTRY_LEN);
+    check_entry(dump + 1 + BBN_TRACE_ENTRY_LEN, BBN_TRACE_SIGN_INPUTS, BBN_TRACE_END_EVENT, 1);
+    CHECK(entry_ticks(dump + 1 + BBN_TRACE_ENTRY_LEN) - entry_ticks(dump + 1) >= 1000);
+}
+
+static void test_leafhash_is_traced(void) {
+    uint8_t dump[DUMP_SIZE];
+    uint8_t leafhash[32];
+
+    memset(&g_bbn_data, 0, sizeof(g_bbn_data));
+    g_bbn_data.fields |= BBN_FIELD(BBN_FIELD_STAKER_PK);
+    g_bbn_data.fields |= BBN_FIELD(BBN_FIELD_TIMELOCK);
+    g_bbn_data.timelock = 1008;
+    bbn_trace_reset();
+    CHECK(compute_bbn_leafhash_timelock(leafhash));
+    CHECK(bbn_trace_dump(dump, sizeof(dump)) == 1 + 2 * BBN_TRACE_ENTRY_LEN);
+    check_entry(dump + 1, BBN_TRACE_LEAF_HASH, BBN_TRACE_BEGIN_EVENT, 0);
+    check_entry(dump + 1 + BBN_TRACE_ENTRY_LEN, BBN_TRACE_LEAF_HASH, BBN_TRACE_END_EVENT, 1);
+
+    // a failed hash still closes its phase, as failed
+    g_bbn_data.fields &= ~BBN_FIELD(BBN_FIELD_TIMELOCK);
+    bbn_trace_reset();
+    CHECK(!compute_bbn_leafhash_timelock(leafhash));
+    CHECK(bbn_trace_dump(dump, sizeof(dump)) == 1 + 2 * BBN_TRACE_ENTRY_LEN);
+    check_entry(dump + 1 + BBN_TRACE_ENTRY_LEN, BBN_TRACE_LEAF_HASH, BBN_TRACE_FAIL_EVENT, 1);
+}
+
+int main(void) {
+    RUN_TEST(test_dump_in_order);
+    RUN_TEST(test_wraps_keeping_latest);
+    RUN_TEST(test_ticks_increase);
+    RUN_TEST(test_leafhash_is_traced);
+    return TEST_RESULT();
+}